@@ -0,0 +1,228 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "analysis.h"
+#include "hash.h"
+#include "jis_process.h"
+#include "search.h"
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool analysis_init(analysis *analysis, const char *executable,
+                   size_t engine_count) {
+  memset(analysis, 0, sizeof(*analysis));
+
+  analysis->engines = calloc(engine_count, sizeof(analysis_engine));
+  if (!analysis->engines) {
+    fprintf(stderr, "error: calloc failed\n");
+    perror("calloc");
+    return false;
+  }
+
+  for (size_t i = 0; i < engine_count; i++) {
+    analysis_engine *engine = &analysis->engines[i];
+    engine->process.child_executable = executable;
+    engine->search = (jis_search){.process = &engine->process};
+    engine->candidate = -1;
+
+    if (!jis_create_proc(&engine->process)) {
+      analysis_free(analysis);
+      return false;
+    }
+    analysis->engine_count++;
+  }
+
+  return true;
+}
+
+void analysis_free(analysis *analysis) {
+  for (size_t i = 0; i < analysis->engine_count; i++)
+    jis_kill_proc(&analysis->engines[i].process);
+  free(analysis->engines);
+  analysis->engines = NULL;
+  analysis->engine_count = 0;
+}
+
+bool analysis_start(analysis *analysis, char *board, bool board_turn) {
+  analysis_stop(analysis);
+
+  memcpy(analysis->board, board, sizeof(analysis->board));
+  analysis->board_turn = board_turn;
+  analysis->hash = board_hash(board, board_turn);
+
+  // The root moves are listed by the first engine found idle.
+  analysis->candidate_count = 0;
+  analysis->next_candidate = 0;
+  analysis->listed = false;
+  analysis->running = true;
+
+  return analysis_update(analysis);
+}
+
+// List the root moves on an idle engine.
+static bool list_moves(analysis *analysis, analysis_engine *engine) {
+  if (!jis_load_position(&engine->process, analysis->board,
+                         analysis->board_turn))
+    return false;
+
+  move moves[ANALYSIS_MAX_CANDIDATES];
+  int move_count =
+      jis_ask_all_moves(&engine->process, analysis->board,
+                        analysis->board_turn, moves, ANALYSIS_MAX_CANDIDATES);
+  if (move_count < 0)
+    return false;
+
+  for (int i = 0; i < move_count; i++)
+    analysis->candidates[i] = (analysis_candidate){.move = moves[i]};
+  analysis->candidate_count = move_count;
+  analysis->listed = true;
+  return true;
+}
+
+// The score of a game for the side that made the candidate move.
+static int game_score(const char *board, int status, bool side, int ply) {
+  switch (status >> 4) {
+  case 1:
+    return 0;
+  case 2:
+    return side ? ANALYSIS_WIN_SCORE - ply : ply - ANALYSIS_WIN_SCORE;
+  case 3:
+    return side ? ply - ANALYSIS_WIN_SCORE : ANALYSIS_WIN_SCORE - ply;
+  }
+
+  // White pieces are uppercase.
+  int score = 0;
+  for (int position = 0; position < 64; position++) {
+    if (board[position] != ' ')
+      score += !isupper(board[position]) == !side ? 1 : -1;
+  }
+  return score;
+}
+
+// Score the game of the engine if it ended or is long enough, or ask the
+// engine for the next move.
+static bool continue_game(analysis *analysis, analysis_engine *engine) {
+  char buffer[64];
+  if (jis_ask(&engine->process, buffer, sizeof(buffer), "status -i\n") < 0)
+    return false;
+  int status = strtol(buffer, NULL, 10);
+
+  if (!(status >> 4) && engine->ply < ANALYSIS_MAX_PLIES)
+    return jis_search_start(&engine->search, -1);
+
+  char board[64];
+  bool turn;
+  if (!jis_copy_position(&engine->process, board, &turn, &status))
+    return false;
+
+  analysis_candidate *candidate = &analysis->candidates[engine->candidate];
+  candidate->score =
+      game_score(board, status, analysis->board_turn, engine->ply);
+  candidate->done = true;
+  engine->candidate = -1;
+  return true;
+}
+
+bool analysis_update(analysis *analysis) {
+  for (size_t i = 0; i < analysis->engine_count; i++) {
+    analysis_engine *engine = &analysis->engines[i];
+
+    char reply[64];
+    jis_search_result result =
+        jis_search_poll(&engine->search, reply, sizeof(reply));
+
+    if (result == SEARCH_ERROR)
+      return false;
+
+    // The engine found the next move of its game.
+    if (result == SEARCH_DONE && engine->candidate >= 0) {
+      engine->ply++;
+      if (!jis_send(&engine->process, "makemove %s\n", reply) ||
+          !continue_game(analysis, engine))
+        return false;
+    }
+
+    if (!analysis->running || engine->search.state != SEARCH_IDLE)
+      continue;
+
+    // Nothing can be handed out before the root moves are known.
+    if (!analysis->listed && !list_moves(analysis, engine))
+      return false;
+
+    if (analysis->next_candidate == analysis->candidate_count)
+      continue;
+
+    // Hand the next root move to the idle engine.
+    engine->candidate = analysis->next_candidate++;
+    engine->ply = 0;
+    move root_move = analysis->candidates[engine->candidate].move;
+
+    if (!jis_load_position(&engine->process, analysis->board,
+                           analysis->board_turn) ||
+        !jis_send(&engine->process, "makemove %s\n", root_move.string) ||
+        !continue_game(analysis, engine))
+      return false;
+  }
+
+  return true;
+}
+
+void analysis_stop(analysis *analysis) {
+  for (size_t i = 0; i < analysis->engine_count; i++) {
+    jis_search_cancel(&analysis->engines[i].search);
+    analysis->engines[i].candidate = -1;
+  }
+  analysis->running = false;
+}
+
+bool analysis_busy(analysis *analysis) {
+  if (analysis->running &&
+      (!analysis->listed ||
+       analysis->next_candidate < analysis->candidate_count))
+    return true;
+
+  for (size_t i = 0; i < analysis->engine_count; i++) {
+    if (analysis->engines[i].search.state != SEARCH_IDLE)
+      return true;
+  }
+  return false;
+}
+
+static int compare_candidates(const void *a, const void *b) {
+  const analysis_candidate *first = a, *second = b;
+  if (first->done != second->done)
+    return first->done ? -1 : 1;
+  return (first->score < second->score) - (first->score > second->score);
+}
+
+size_t analysis_ranking(analysis *analysis, analysis_candidate *ranking,
+                        size_t max_candidates) {
+  analysis_candidate sorted[ANALYSIS_MAX_CANDIDATES];
+  memcpy(sorted, analysis->candidates,
+         analysis->candidate_count * sizeof(analysis_candidate));
+  qsort(sorted, analysis->candidate_count, sizeof(analysis_candidate),
+        compare_candidates);
+
+  size_t count = analysis->candidate_count < max_candidates
+                     ? analysis->candidate_count
+                     : max_candidates;
+  memcpy(ranking, sorted, count * sizeof(analysis_candidate));
+  return count;
+}
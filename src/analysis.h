@@ -0,0 +1,97 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include "jis_process.h"
+#include "search.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ANALYSIS_MAX_CANDIDATES 128
+
+// A move is scored by letting the engine play the game on from it, as the
+// protocol has no command that scores a position. Games that do not end within
+// ANALYSIS_MAX_PLIES are scored by the pieces left.
+#define ANALYSIS_MAX_PLIES 40
+#define ANALYSIS_WIN_SCORE 1000
+
+typedef struct {
+  move move;
+  bool done;
+  // The score of the game after the move, for the side making the move. Wins
+  // score ANALYSIS_WIN_SCORE less the plies they took, losses the opposite,
+  // and unfinished games the difference in the number of pieces.
+  int score;
+} analysis_candidate;
+
+typedef struct {
+  jis_process process;
+  jis_search search;
+  // The candidate whose game is being played, or -1.
+  int candidate;
+  // Plies played after the candidate move.
+  int ply;
+} analysis_engine;
+
+// Evaluates the moves of a position in parallel, every engine taking one root
+// move at a time.
+typedef struct {
+  analysis_engine *engines;
+  size_t engine_count;
+
+  char board[64];
+  bool board_turn;
+  uint64_t hash;
+
+  analysis_candidate candidates[ANALYSIS_MAX_CANDIDATES];
+  size_t candidate_count;
+  size_t next_candidate;
+
+  // Whether the root moves were listed, which waits for an idle engine.
+  bool listed;
+
+  bool running;
+} analysis;
+
+// Spawn the analysis engines.
+bool analysis_init(analysis *analysis, const char *executable,
+                   size_t engine_count);
+
+void analysis_free(analysis *analysis);
+
+// Start analysing a position. The root moves are listed by the first engine
+// to become idle, so this never waits for an abandoned evaluation.
+bool analysis_start(analysis *analysis, char *board, bool board_turn);
+
+// Collect the finished evaluations and hand out the remaining moves without
+// blocking.
+bool analysis_update(analysis *analysis);
+
+// Stop analysing. Running evaluations are drained in later updates.
+void analysis_stop(analysis *analysis);
+
+// Whether evaluations are running, being drained or waiting for an engine.
+bool analysis_busy(analysis *analysis);
+
+// Copy the candidates ordered from best to worst, the unfinished ones last.
+size_t analysis_ranking(analysis *analysis, analysis_candidate *ranking,
+                        size_t max_candidates);
+
+#endif
@@ -0,0 +1,326 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "bench.h"
+#include "fen.h"
+#include "fenbulk.h"
+#include "gui.h"
+#include "hash.h"
+#include "history.h"
+#include "jis_process.h"
+#include "record.h"
+#include "timing.h"
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Games longer than this are cut short, in case the engine keeps shuffling.
+#define BENCH_MAX_GAME_PLIES 400
+
+// Positions loaded at once by the bulk parsers.
+#define BENCH_FEN_BATCH 4096
+
+// Every parser is timed over at least this long.
+#define BENCH_FEN_MIN_NS 200000000
+
+// Changed copies of every line checked against load_fen.
+#define BENCH_FEN_MUTATIONS 16
+
+bool bench_run(const char *executable, long plies) {
+  jis_process process = {.child_executable = executable};
+  if (!jis_create_proc(&process))
+    return false;
+
+  char start_board[64];
+  bool start_turn;
+  int start_status;
+  if (!jis_copy_position(&process, start_board, &start_turn, &start_status)) {
+    jis_kill_proc(&process);
+    return false;
+  }
+
+  // A fixed generator keeps the games the same on every run.
+  uint64_t random = 0x6a6973;
+
+  long played = 0, games = 0, fens = 0;
+  uint64_t checksum = 0;
+  uint64_t start_ns = timing_now_ns();
+
+  while (played < plies) {
+    char board[64];
+    bool board_turn = start_turn;
+    int board_status = start_status;
+    memcpy(board, start_board, sizeof(board));
+
+    history history;
+    if (!history_init(&history, board, board_turn, board_status) ||
+        !jis_load_position(&process, board, board_turn))
+      break;
+
+    for (int ply = 0; ply < BENCH_MAX_GAME_PLIES && played < plies &&
+                      board_status >> 4 == 0;
+         ply++, played++) {
+      move moves[256];
+      int move_count =
+          jis_ask_all_moves(&process, board, board_turn, moves, 256);
+      if (move_count <= 0)
+        break;
+
+      random = random * 6364136223846793005 + 1442695040888963407;
+      move chosen = moves[(random >> 33) % move_count];
+
+      move last_move;
+      if (!gui_make_move(&process, NULL, board, &board_turn, &board_status,
+                         chosen.string, &last_move, &history, NULL)) {
+        history_free(&history);
+        jis_kill_proc(&process);
+        return false;
+      }
+
+      // Round trip the position and the move through their encodings.
+      char fen[128];
+      char parsed_board[64];
+      bool parsed_turn;
+      get_fen_string(fen, board, board_turn);
+      if (!load_fen(fen, parsed_board, &parsed_turn) ||
+          memcmp(parsed_board, board, sizeof(board))) {
+        fprintf(stderr, "error: FEN round trip failed for %s\n", fen);
+        history_free(&history);
+        jis_kill_proc(&process);
+        return false;
+      }
+      fens++;
+
+      uint16_t words[2];
+      move unpacked;
+      record_pack_move(last_move, words);
+      record_unpack_move(words, 2, &unpacked);
+
+      checksum ^= board_hash(parsed_board, parsed_turn) + unpacked.to;
+    }
+
+    // Walk back and forth through the game as well.
+    history_go(&history, 0);
+    history_go(&history, history.length);
+
+    history_free(&history);
+    games++;
+  }
+
+  uint64_t elapsed_ns = timing_now_ns() - start_ns;
+  jis_kill_proc(&process);
+
+  printf("bench: %ld plies, %ld games, %ld FENs, checksum %016" PRIx64 "\n",
+         played, games, fens, checksum);
+  printf("bench: %.1f ms, %.0f plies/s\n", elapsed_ns / 1e6,
+         played / (elapsed_ns / 1e9));
+  return played == plies;
+}
+
+// Load a line the way callers of load_fen do, from a string of its own.
+static bool reference_load(const char *line, size_t length, char board[64],
+                           bool *turn) {
+  char string[length + 1];
+  memcpy(string, line, length);
+  string[length] = '\0';
+  return load_fen(string, board, turn);
+}
+
+// Compare the bulk parser with load_fen on a single line.
+static bool same_as_reference(fen_parser parser, const char *line,
+                              size_t length) {
+  char board[64];
+  bool turn;
+  bool valid = reference_load(line, length, board, &turn);
+
+  fen_position position;
+  size_t used;
+  if (!load_fens_with(parser, line, length, &position, 1, &used))
+    position.valid = false;
+
+  return position.valid == valid &&
+         (!valid || (position.turn == turn &&
+                     !memcmp(position.board, board, sizeof(position.board))));
+}
+
+// Check every parser on the lines of the text and on copies of them changed at
+// random. Returns the number of lines the parsers got wrong.
+static uint64_t check_mutations(const char *text, size_t length,
+                                uint64_t *checked) {
+  static const char ALPHABET[] = "PNpn12345678/ wb09xP/\0";
+
+  // A fixed generator keeps the checks the same on every run.
+  uint64_t random = 0x66656e;
+  uint64_t mismatches = 0;
+
+  for (size_t offset = 0; offset < length;) {
+    const char *newline = memchr(text + offset, '\n', length - offset);
+    size_t line_length = newline ? (size_t)(newline - text) - offset
+                                 : length - offset;
+
+    for (fen_parser parser = 0; parser < FEN_PARSER_COUNT; parser++) {
+      if (fen_parser_supported(parser) &&
+          !same_as_reference(parser, text + offset, line_length))
+        mismatches++;
+    }
+    (*checked)++;
+
+    char line[line_length + 2];
+    for (int mutation = 0; mutation < BENCH_FEN_MUTATIONS; mutation++) {
+      memcpy(line, text + offset, line_length);
+      size_t mutated_length = line_length;
+
+      random = random * 6364136223846793005 + 1442695040888963407;
+      size_t at = line_length ? (random >> 33) % line_length : 0;
+      char c = ALPHABET[(random >> 20) % (sizeof(ALPHABET) - 1)];
+
+      // Replace, insert or remove a character.
+      switch ((random >> 8) % 3) {
+      case 0:
+        if (line_length)
+          line[at] = c;
+        break;
+      case 1:
+        memmove(line + at + 1, line + at, line_length - at);
+        line[at] = c;
+        mutated_length++;
+        break;
+      case 2:
+        if (line_length) {
+          memmove(line + at, line + at + 1, line_length - at - 1);
+          mutated_length--;
+        }
+        break;
+      }
+
+      for (fen_parser parser = 0; parser < FEN_PARSER_COUNT; parser++) {
+        if (fen_parser_supported(parser) &&
+            !same_as_reference(parser, line, mutated_length))
+          mismatches++;
+      }
+      (*checked)++;
+    }
+
+    offset += line_length + 1;
+  }
+  return mismatches;
+}
+
+bool bench_fens(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "error: could not open %s\n", path);
+    perror("open");
+    return false;
+  }
+
+  struct stat stat;
+  if (fstat(fd, &stat) < 0 || stat.st_size == 0) {
+    fprintf(stderr, "error: %s is empty\n", path);
+    close(fd);
+    return false;
+  }
+
+  size_t length = stat.st_size;
+  const char *text = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (text == MAP_FAILED) {
+    fprintf(stderr, "error: could not map %s\n", path);
+    perror("mmap");
+    return false;
+  }
+
+  // Time load_fen on every line as the reference.
+  size_t line_count = 0, accepted = 0;
+  uint64_t rounds = 0, start_ns = timing_now_ns(), elapsed_ns;
+  do {
+    for (size_t offset = 0; offset < length;) {
+      const char *newline = memchr(text + offset, '\n', length - offset);
+      size_t line_length = newline ? (size_t)(newline - text) - offset
+                                   : length - offset;
+
+      char board[64];
+      bool turn;
+      bool valid = reference_load(text + offset, line_length, board, &turn);
+      if (!rounds) {
+        line_count++;
+        accepted += valid;
+      }
+      offset += line_length + 1;
+    }
+    rounds++;
+    elapsed_ns = timing_now_ns() - start_ns;
+  } while (elapsed_ns < BENCH_FEN_MIN_NS);
+
+  printf("fens: %zu lines, %zu accepted, %.1f MB\n", line_count, accepted,
+         length / 1e6);
+  printf("fens: load_fen %.1f MB/s\n", rounds * length / (elapsed_ns / 1e3));
+
+  fen_position *positions = malloc(BENCH_FEN_BATCH * sizeof(fen_position));
+  if (!positions) {
+    fprintf(stderr, "error: malloc failed\n");
+    munmap((void *)text, length);
+    return false;
+  }
+
+  bool success = true;
+  for (fen_parser parser = 0; parser < FEN_PARSER_COUNT; parser++) {
+    if (!fen_parser_supported(parser))
+      continue;
+
+    size_t parser_accepted = 0;
+    rounds = 0;
+    start_ns = timing_now_ns();
+    do {
+      for (size_t offset = 0; offset < length;) {
+        size_t used;
+        size_t count =
+            load_fens_with(parser, text + offset, length - offset, positions,
+                           BENCH_FEN_BATCH, &used);
+        if (!rounds) {
+          for (size_t i = 0; i < count; i++)
+            parser_accepted += positions[i].valid;
+        }
+        offset += used;
+      }
+      rounds++;
+      elapsed_ns = timing_now_ns() - start_ns;
+    } while (elapsed_ns < BENCH_FEN_MIN_NS);
+
+    printf("fens: %s %.1f MB/s%s\n", FEN_PARSER_NAMES[parser],
+           rounds * length / (elapsed_ns / 1e3),
+           parser_accepted == accepted ? "" : ", accepted a different count");
+    success = success && parser_accepted == accepted;
+  }
+  free(positions);
+
+  uint64_t checked = 0;
+  uint64_t mismatches = check_mutations(text, length, &checked);
+  printf("fens: %" PRIu64 " lines checked, %" PRIu64
+         " mismatches\n",
+         checked, mismatches);
+
+  munmap((void *)text, length);
+  return success && !mismatches;
+}
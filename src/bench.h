@@ -0,0 +1,31 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+
+// Run a non-interactive workload against the engine: play games through the
+// same paths as the GUI, parse every position as FEN and pack every move. Used
+// to train profile guided builds and to compare builds against each other.
+bool bench_run(const char *executable, long plies);
+
+// Time load_fen and the bulk parsers on a file of FEN lines, and check that
+// the bulk parsers load every line, and changed copies of it, as load_fen does.
+bool bench_fens(const char *path);
+
+#endif
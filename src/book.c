@@ -0,0 +1,228 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "book.h"
+#include "fen.h"
+#include "hash.h"
+#include "jis_process.h"
+#include "position.h"
+#include "record.h"
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool book_open(book *book, const char *path) {
+  memset(book, 0, sizeof(*book));
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "error: could not open %s\n", path);
+    perror("open");
+    return false;
+  }
+
+  struct stat stat;
+  if (fstat(fd, &stat) < 0 || stat.st_size < BOOK_HEADER_SIZE) {
+    fprintf(stderr, "error: %s is not an opening book\n", path);
+    close(fd);
+    return false;
+  }
+
+  book->map_size = stat.st_size;
+  book->map = mmap(NULL, book->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (book->map == MAP_FAILED) {
+    fprintf(stderr, "error: could not map %s\n", path);
+    perror("mmap");
+    book->map = NULL;
+    return false;
+  }
+
+  const uint32_t *header = book->map;
+  book->entry_count = ((const uint64_t *)book->map)[1];
+  book->entries =
+      (const book_entry *)((const char *)book->map + BOOK_HEADER_SIZE);
+
+  if (memcmp(book->map, BOOK_MAGIC, 4) || header[1] != BOOK_VERSION ||
+      book->map_size !=
+          BOOK_HEADER_SIZE + book->entry_count * sizeof(book_entry)) {
+    fprintf(stderr, "error: %s is not an opening book\n", path);
+    book_close(book);
+    return false;
+  }
+
+  return true;
+}
+
+void book_close(book *book) {
+  if (book->map)
+    munmap(book->map, book->map_size);
+  book->map = NULL;
+}
+
+bool book_probe(book *book, const char *board, bool turn, move *result) {
+  if (!book->map)
+    return false;
+
+  int transform;
+  uint64_t key = board_hash_canonical(board, turn, &transform);
+
+  // Find the first entry of the position.
+  size_t low = 0, high = book->entry_count;
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    if (book->entries[middle].key < key)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+
+  unsigned long total_weight = 0;
+  size_t end = low;
+  for (; end < book->entry_count && book->entries[end].key == key; end++)
+    total_weight += book->entries[end].weight;
+
+  if (!total_weight)
+    return false;
+
+  // Choose a move, proportionally to how often it was played.
+  unsigned long choice = rand() % total_weight;
+  size_t index = low;
+  while (choice >= book->entries[index].weight)
+    choice -= book->entries[index++].weight;
+
+  uint16_t word = book->entries[index].move;
+  move canonical;
+  if (!record_unpack_move(&word, 1, &canonical))
+    return false;
+
+  // Bring the move back to the frame of the board.
+  *result = (move){.from = transform_position(transform, canonical.from),
+                   .to = transform_position(transform, canonical.to),
+                   .capture = transform_position(transform, canonical.capture)};
+  get_position_str(result->from, result->string);
+  get_position_str(result->to, result->string + 2);
+  return true;
+}
+
+static int compare_entries(const void *a, const void *b) {
+  const book_entry *first = a, *second = b;
+  if (first->key != second->key)
+    return first->key < second->key ? -1 : 1;
+  return (int)first->move - (int)second->move;
+}
+
+bool book_build(const char *archive_path, const char *book_path,
+                jis_process *process) {
+  game_archive archive;
+  if (!game_archive_open(&archive, archive_path))
+    return false;
+
+  size_t capacity = archive.game_count * BOOK_MAX_PLY + 1;
+  book_entry *entries = malloc(capacity * sizeof(book_entry));
+  size_t entry_count = 0;
+
+  if (!entries) {
+    fprintf(stderr, "error: malloc failed\n");
+    perror("malloc");
+    game_archive_close(&archive);
+    return false;
+  }
+
+  for (size_t index = 0; index < archive.game_count; index++) {
+    game_record record;
+    char board[64];
+    bool turn;
+    int status;
+
+    if (!game_archive_get(&archive, index, &record) ||
+        !load_fen(record.fen, board, &turn) ||
+        !jis_load_position(process, board, turn))
+      continue;
+
+    size_t offset = 0;
+    move recorded_move;
+    for (int ply = 0; ply < BOOK_MAX_PLY &&
+                      game_record_next_move(&record, &offset, &recorded_move);
+         ply++) {
+      int transform;
+      uint64_t key = board_hash_canonical(board, turn, &transform);
+
+      move canonical = {
+          .from = transform_position(transform, recorded_move.from),
+          .to = transform_position(transform, recorded_move.to),
+          .capture = transform_position(transform, recorded_move.capture)};
+
+      // Moves that need more than a word are not worth the space.
+      uint16_t words[2];
+      if (record_pack_move(canonical, words) == 1)
+        entries[entry_count++] = (book_entry){.key = key, .move = words[0]};
+
+      if (!jis_make_move(process, board, &turn, &status,
+                         recorded_move.string))
+        break;
+    }
+  }
+  game_archive_close(&archive);
+
+  // Merge the duplicate moves into weights.
+  qsort(entries, entry_count, sizeof(book_entry), compare_entries);
+
+  size_t merged_count = 0;
+  for (size_t i = 0; i < entry_count; i++) {
+    if (merged_count && entries[merged_count - 1].key == entries[i].key &&
+        entries[merged_count - 1].move == entries[i].move) {
+      if (entries[merged_count - 1].weight < UINT16_MAX)
+        entries[merged_count - 1].weight++;
+      continue;
+    }
+
+    entries[merged_count] = entries[i];
+    entries[merged_count++].weight = 1;
+  }
+
+  FILE *file = fopen(book_path, "wb");
+  if (!file) {
+    fprintf(stderr, "error: could not open %s\n", book_path);
+    perror("fopen");
+    free(entries);
+    return false;
+  }
+
+  uint32_t header[4] = {0, BOOK_VERSION};
+  memcpy(header, BOOK_MAGIC, 4);
+  ((uint64_t *)header)[1] = merged_count;
+
+  bool success =
+      fwrite(header, sizeof(header), 1, file) == 1 &&
+      fwrite(entries, sizeof(book_entry), merged_count, file) == merged_count;
+  free(entries);
+
+  if (fclose(file) || !success) {
+    fprintf(stderr, "error: could not write %s\n", book_path);
+    return false;
+  }
+
+  printf("%zu positions and moves written to %s\n", merged_count, book_path);
+  return true;
+}
@@ -0,0 +1,65 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef BOOK_H
+#define BOOK_H
+
+#include "jis_process.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A book file is a header followed by entries sorted by key and move, in the
+// byte order of the machine. Keys are canonical hashes of the positions and
+// moves are packed as in game archives, in the canonical frame.
+#define BOOK_MAGIC "JISB"
+#define BOOK_VERSION 1
+#define BOOK_HEADER_SIZE 16
+
+// Only the moves of the first plies are worth keeping.
+#define BOOK_MAX_PLY 24
+
+typedef struct {
+  uint64_t key;
+  uint16_t move;
+  uint16_t weight;
+  uint32_t reserved;
+} book_entry;
+
+typedef struct {
+  void *map;
+  size_t map_size;
+
+  const book_entry *entries;
+  size_t entry_count;
+} book;
+
+// Map a book file into memory.
+bool book_open(book *book, const char *path);
+
+void book_close(book *book);
+
+// Look up a move for the position, choosing between the known moves by their
+// weights. Returns false if the position is not in the book.
+bool book_probe(book *book, const char *board, bool turn, move *result);
+
+// Build a book from the games of an archive. The games are replayed through
+// the process to find the positions they went through.
+bool book_build(const char *archive_path, const char *book_path,
+                jis_process *process);
+
+#endif
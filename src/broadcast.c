@@ -0,0 +1,419 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "broadcast.h"
+#include "fen.h"
+#include "position.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static void square_string(int position, char buffer[3]) {
+  if (is_valid(position))
+    get_position_str(position, buffer);
+  else
+    strcpy(buffer, "-");
+}
+
+static int parse_square(char *buffer) {
+  return strcmp(buffer, "-") ? str_to_position(buffer) : POSITION_INV;
+}
+
+static bool set_address(struct sockaddr_un *address, const char *path) {
+  if (strlen(path) >= sizeof(address->sun_path)) {
+    fprintf(stderr, "error: socket path %s is too long\n", path);
+    return false;
+  }
+
+  memset(address, 0, sizeof(*address));
+  address->sun_family = AF_UNIX;
+  strcpy(address->sun_path, path);
+  return true;
+}
+
+bool broadcast_start(broadcaster *broadcaster, const char *path) {
+  memset(broadcaster, 0, sizeof(*broadcaster));
+  broadcaster->fd = -1;
+
+  struct sockaddr_un address;
+  if (!set_address(&address, path))
+    return false;
+  strcpy(broadcaster->path, path);
+
+  // Spectators are accepted from the main loop, which must never wait.
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    fprintf(stderr, "error: could not create a socket\n");
+    perror("socket");
+    return false;
+  }
+
+  // A socket left behind by an earlier run would make bind fail.
+  unlink(path);
+  if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0 ||
+      listen(fd, 16) < 0) {
+    fprintf(stderr, "error: could not listen on %s\n", path);
+    perror("bind");
+    close(fd);
+    return false;
+  }
+
+  broadcaster->fd = fd;
+  return true;
+}
+
+void broadcast_stop(broadcaster *broadcaster) {
+  if (broadcaster->fd < 0)
+    return;
+
+  for (int i = 0; i < broadcaster->client_count; i++)
+    close(broadcaster->clients[i].fd);
+  broadcaster->client_count = 0;
+
+  close(broadcaster->fd);
+  unlink(broadcaster->path);
+  broadcaster->fd = -1;
+}
+
+static void drop_client(broadcaster *broadcaster, int index) {
+  close(broadcaster->clients[index].fd);
+
+  // The order of the spectators does not matter.
+  broadcaster->client_count--;
+  if (index != broadcaster->client_count)
+    broadcaster->clients[index] =
+        broadcaster->clients[broadcaster->client_count];
+}
+
+// Send as much of the pending lines as the spectator takes. Returns false if
+// the spectator went away.
+static bool flush_client(broadcast_client *client) {
+  while (client->pending_length) {
+    ssize_t sent = send(client->fd, client->pending, client->pending_length,
+                        MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (sent < 0) {
+      if (errno == EINTR)
+        continue;
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+
+    // The first pending line was partly sent unless a newline was the last
+    // byte sent.
+    if (sent > 0)
+      client->partial = client->pending[sent - 1] != '\n';
+
+    client->pending_length -= sent;
+    memmove(client->pending, client->pending + sent, client->pending_length);
+  }
+  client->partial = false;
+  return true;
+}
+
+// Queue a line for the spectator, or give up on the pending lines if there is
+// no room left.
+static void queue_line(broadcaster *broadcaster, broadcast_client *client,
+                       const char *line, size_t length) {
+  if (client->pending_length + length <= BROADCAST_BUFFER_SIZE) {
+    memcpy(client->pending + client->pending_length, line, length);
+    client->pending_length += length;
+    return;
+  }
+
+  // The rest of a line that was partly sent must still follow, or the
+  // spectator would read garbage.
+  size_t kept = 0;
+  if (client->partial)
+    kept = (char *)memchr(client->pending, '\n', client->pending_length) -
+           client->pending + 1;
+
+  for (size_t i = kept; i < client->pending_length; i++)
+    broadcaster->dropped_lines += client->pending[i] == '\n';
+  broadcaster->dropped_lines++;
+
+  client->pending_length = kept;
+  client->resync = true;
+}
+
+static size_t format_keyframe(broadcaster *broadcaster,
+                              char line[BROADCAST_LINE_SIZE]) {
+  char fen[80];
+  get_fen_string(fen, broadcaster->board, broadcaster->turn);
+
+  // The starting position has no last move.
+  move last_move = broadcaster->last_move;
+  if (!is_valid(last_move.from))
+    last_move.to = last_move.capture = POSITION_INV;
+
+  char from[3], to[3], capture[3];
+  square_string(last_move.from, from);
+  square_string(last_move.to, to);
+  square_string(last_move.capture, capture);
+
+  // The FEN string ends with the turn.
+  return snprintf(line, BROADCAST_LINE_SIZE, "k %s %d %s %s %s %d\n", fen,
+                  broadcaster->status, from, to, capture,
+                  broadcaster->lost_on_time);
+}
+
+// Whether the position follows from the published one by its last move alone.
+static bool follows_by_move(broadcaster *broadcaster, const char *board,
+                            bool turn, move last_move) {
+  move move = last_move;
+  if (!broadcaster->published || !is_valid(move.from) ||
+      !is_valid(move.to) || turn == broadcaster->turn ||
+      board[move.from] != ' ' ||
+      (is_valid(move.capture) && move.capture != move.to &&
+       board[move.capture] != ' '))
+    return false;
+
+  if (broadcaster->last_move.from == move.from &&
+      broadcaster->last_move.to == move.to)
+    return false;
+
+  for (int position = 0; position < 64; position++) {
+    if (board[position] != broadcaster->board[position] &&
+        position != move.from && position != move.to &&
+        position != move.capture)
+      return false;
+  }
+  return true;
+}
+
+// Publish the position, as a move if it follows from the last one.
+static void publish(broadcaster *broadcaster, const char *board, bool turn,
+                    int status, bool lost_on_time, move last_move) {
+  char line[BROADCAST_LINE_SIZE];
+  size_t length;
+
+  if (follows_by_move(broadcaster, board, turn, last_move) &&
+      broadcaster->moves_since_keyframe < BROADCAST_KEYFRAME_INTERVAL) {
+    char from[3], to[3], capture[3];
+    square_string(last_move.from, from);
+    square_string(last_move.to, to);
+    square_string(last_move.capture, capture);
+    length = snprintf(line, sizeof(line), "m %s %s %s %c %d %d\n", from, to,
+                      capture, board[last_move.to], status, lost_on_time);
+    broadcaster->moves_since_keyframe++;
+  } else {
+    length = 0;
+    broadcaster->moves_since_keyframe = 0;
+  }
+
+  broadcaster->published = true;
+  memcpy(broadcaster->board, board, sizeof(broadcaster->board));
+  broadcaster->turn = turn;
+  broadcaster->status = status;
+  broadcaster->lost_on_time = lost_on_time;
+  broadcaster->last_move = last_move;
+
+  if (!length)
+    length = format_keyframe(broadcaster, line);
+
+  // Spectators waiting for a keyframe get one once they catch up.
+  for (int i = 0; i < broadcaster->client_count; i++) {
+    broadcast_client *client = &broadcaster->clients[i];
+    if (!client->resync)
+      queue_line(broadcaster, client, line, length);
+  }
+}
+
+void broadcast_update(broadcaster *broadcaster, const char *board, bool turn,
+                      int status, bool lost_on_time, move last_move) {
+  if (broadcaster->fd < 0)
+    return;
+
+  for (;;) {
+    // Spectators are only written to with MSG_DONTWAIT, so their sockets can
+    // stay blocking.
+    int fd = accept(broadcaster->fd, NULL, NULL);
+    if (fd < 0)
+      break;
+
+    if (broadcaster->client_count == BROADCAST_MAX_CLIENTS) {
+      close(fd);
+      continue;
+    }
+
+    // New spectators start with a keyframe.
+    broadcaster->clients[broadcaster->client_count++] =
+        (broadcast_client){.fd = fd, .resync = true};
+  }
+
+  if (!broadcaster->published ||
+      memcmp(board, broadcaster->board, sizeof(broadcaster->board)) ||
+      turn != broadcaster->turn || status != broadcaster->status ||
+      lost_on_time != broadcaster->lost_on_time ||
+      last_move.from != broadcaster->last_move.from ||
+      last_move.to != broadcaster->last_move.to)
+    publish(broadcaster, board, turn, status, lost_on_time, last_move);
+
+  char keyframe[BROADCAST_LINE_SIZE];
+  size_t keyframe_length = 0;
+
+  for (int i = 0; i < broadcaster->client_count;) {
+    broadcast_client *client = &broadcaster->clients[i];
+    if (!flush_client(client)) {
+      drop_client(broadcaster, i);
+      continue;
+    }
+
+    // Spectators that caught up are sent the whole position again.
+    if (client->resync && client->pending_length == 0) {
+      if (!keyframe_length)
+        keyframe_length = format_keyframe(broadcaster, keyframe);
+
+      client->resync = false;
+      queue_line(broadcaster, client, keyframe, keyframe_length);
+      if (!flush_client(client)) {
+        drop_client(broadcaster, i);
+        continue;
+      }
+    }
+    i++;
+  }
+}
+
+bool broadcast_backlogged(broadcaster *broadcaster) {
+  for (int i = 0; i < broadcaster->client_count; i++) {
+    if (broadcaster->clients[i].pending_length ||
+        broadcaster->clients[i].resync)
+      return true;
+  }
+  return false;
+}
+
+bool broadcast_connect(broadcast_view *view, const char *path) {
+  memset(view, 0, sizeof(*view));
+  view->fd = -1;
+
+  struct sockaddr_un address;
+  if (!set_address(&address, path))
+    return false;
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    fprintf(stderr, "error: could not create a socket\n");
+    perror("socket");
+    return false;
+  }
+
+  if (connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+    fprintf(stderr, "error: could not connect to %s\n", path);
+    perror("connect");
+    close(fd);
+    return false;
+  }
+
+  view->fd = fd;
+  return true;
+}
+
+void broadcast_disconnect(broadcast_view *view) {
+  if (view->fd >= 0)
+    close(view->fd);
+  view->fd = -1;
+}
+
+// Apply a line to the view. Lines that do not parse are ignored.
+static void apply_line(broadcast_view *view, char *line, bool *moved) {
+  char from[3], to[3], capture[3];
+
+  char piece;
+  int status, lost_on_time;
+  if (sscanf(line, "m %2s %2s %2s %c %d %d", from, to, capture, &piece,
+             &status, &lost_on_time) == 6) {
+    // A move means nothing without the position it was made in. Lines come
+    // from another process and are checked like FEN strings are.
+    move move = {parse_square(from), parse_square(to), parse_square(capture)};
+    if (!view->synced || !is_valid(move.from) || !is_valid(move.to) ||
+        !piece || !strchr("PNpn", piece))
+      return;
+
+    view->board[move.from] = ' ';
+    if (is_valid(move.capture))
+      view->board[move.capture] = ' ';
+    view->board[move.to] = piece;
+    view->turn = !view->turn;
+    view->status = status;
+    view->lost_on_time = lost_on_time;
+
+    snprintf(move.string, sizeof(move.string), "%s%s", from, to);
+    view->last_move = move;
+    *moved = true;
+    return;
+  }
+
+  char fen[80], turn;
+  if (sscanf(line, "k %71s %c %d %2s %2s %2s %d", fen, &turn, &status, from,
+             to, capture, &lost_on_time) == 7) {
+    char fen_string[82];
+    snprintf(fen_string, sizeof(fen_string), "%s %c", fen, turn);
+
+    char board[64];
+    bool board_turn;
+    if (!load_fen(fen_string, board, &board_turn))
+      return;
+
+    memcpy(view->board, board, sizeof(board));
+    view->turn = board_turn;
+    view->status = status;
+    view->lost_on_time = lost_on_time;
+    view->last_move =
+        (move){parse_square(from), parse_square(to), parse_square(capture)};
+    if (is_valid(view->last_move.from) && is_valid(view->last_move.to))
+      snprintf(view->last_move.string, sizeof(view->last_move.string), "%s%s",
+               from, to);
+    view->synced = true;
+  }
+}
+
+bool broadcast_receive(broadcast_view *view, bool *moved) {
+  *moved = false;
+
+  for (;;) {
+    ssize_t length =
+        recv(view->fd, view->buffer + view->length,
+             sizeof(view->buffer) - view->length - 1, MSG_DONTWAIT);
+    if (length == 0)
+      return false;
+    if (length < 0) {
+      if (errno == EINTR)
+        continue;
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    view->length += length;
+    view->buffer[view->length] = '\0';
+
+    char *line = view->buffer, *end;
+    while ((end = strchr(line, '\n'))) {
+      *end = '\0';
+      apply_line(view, line, moved);
+      line = end + 1;
+    }
+
+    // Keep the start of a line that did not fully arrive. A line filling the
+    // whole buffer can not be valid and is thrown away.
+    view->length -= line - view->buffer;
+    if (view->length == sizeof(view->buffer) - 1)
+      view->length = 0;
+    memmove(view->buffer, line, view->length);
+  }
+}
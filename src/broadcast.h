@@ -0,0 +1,118 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include "jis_process.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The shown position is broadcast as text lines,
+//
+//   m from to capture piece status timeout     a move, with the piece left on
+//                                              to
+//   k fen turn status from to capture timeout  the whole position and its last
+//                                              move
+//
+// with - for missing squares, and timeout 1 if the game was lost on time.
+// Spectators start from a keyframe, and one is sent every
+// BROADCAST_KEYFRAME_INTERVAL moves so that a spectator that went wrong does
+// not stay wrong.
+#define BROADCAST_KEYFRAME_INTERVAL 32
+
+#define BROADCAST_MAX_CLIENTS 64
+
+// The bytes kept for a spectator that does not read fast enough. Once they
+// are full, the spectator is skipped until it catches up and is then sent a
+// keyframe instead.
+#define BROADCAST_BUFFER_SIZE 4096
+
+#define BROADCAST_LINE_SIZE 128
+
+typedef struct {
+  int fd;
+
+  char pending[BROADCAST_BUFFER_SIZE];
+  size_t pending_length;
+
+  // Whether the first pending line was partly sent.
+  bool partial;
+
+  // Whether the spectator missed lines and waits for a keyframe.
+  bool resync;
+} broadcast_client;
+
+typedef struct {
+  int fd;
+  char path[108];
+
+  broadcast_client clients[BROADCAST_MAX_CLIENTS];
+  int client_count;
+
+  // The last position published.
+  bool published;
+  char board[64];
+  bool turn;
+  int status;
+  bool lost_on_time;
+  move last_move;
+  int moves_since_keyframe;
+
+  uint64_t dropped_lines;
+} broadcaster;
+
+// A spectator of a broadcast game.
+typedef struct {
+  int fd;
+
+  char buffer[BROADCAST_BUFFER_SIZE];
+  size_t length;
+
+  // Whether a keyframe arrived, the position is unknown before.
+  bool synced;
+  char board[64];
+  bool turn;
+  int status;
+  bool lost_on_time;
+  move last_move;
+} broadcast_view;
+
+// Broadcast to spectators connecting to a Unix socket at path. A broadcaster
+// with a negative fd does nothing.
+bool broadcast_start(broadcaster *broadcaster, const char *path);
+
+void broadcast_stop(broadcaster *broadcaster);
+
+// Accept new spectators, publish the position if it changed and send what
+// slow spectators could not take before. Never blocks.
+void broadcast_update(broadcaster *broadcaster, const char *board, bool turn,
+                      int status, bool lost_on_time, move last_move);
+
+// Whether lines are still waiting to be sent to a spectator.
+bool broadcast_backlogged(broadcaster *broadcaster);
+
+bool broadcast_connect(broadcast_view *view, const char *path);
+
+void broadcast_disconnect(broadcast_view *view);
+
+// Apply the lines that arrived without blocking. Sets moved if a move was
+// applied. Returns false if the broadcast ended.
+bool broadcast_receive(broadcast_view *view, bool *moved);
+
+#endif
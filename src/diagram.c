@@ -0,0 +1,295 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "diagram.h"
+#include "fenbulk.h"
+#include "gui.h"
+#include "position.h"
+#include "timing.h"
+
+#include <raylib.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Diagrams are as large as the board in the window.
+#define DIAGRAM_SIZE (8 * GRID_SQUARE_SIZE)
+
+typedef struct {
+  Image image;
+
+  // Diagrams of the atlas not encoded yet, the last encoder frees it.
+  int remaining;
+} diagram_atlas;
+
+typedef struct {
+  diagram_atlas *atlas;
+  int cell;
+
+  // The line of the FEN string, from 1.
+  size_t line;
+} diagram_job;
+
+typedef struct {
+  const char *directory;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t changed;
+
+  // A ring of the diagrams waiting to be encoded.
+  diagram_job jobs[DIAGRAM_MAX_ATLASES * DIAGRAM_BATCH];
+  size_t first_job;
+  size_t job_count;
+
+  int atlas_count;
+  bool done;
+  size_t written;
+  size_t failed;
+} diagram_queue;
+
+static void *encode_worker(void *argument) {
+  diagram_queue *queue = argument;
+
+  for (;;) {
+    pthread_mutex_lock(&queue->mutex);
+    while (!queue->job_count && !queue->done)
+      pthread_cond_wait(&queue->changed, &queue->mutex);
+    if (!queue->job_count) {
+      pthread_mutex_unlock(&queue->mutex);
+      return NULL;
+    }
+
+    diagram_job job = queue->jobs[queue->first_job];
+    queue->first_job = (queue->first_job + 1) % (sizeof(queue->jobs) /
+                                                 sizeof(queue->jobs[0]));
+    queue->job_count--;
+    pthread_mutex_unlock(&queue->mutex);
+
+    // Textures are read back bottom row first, so the rows of the atlas are
+    // flipped and each diagram is flipped back on its own.
+    Image *atlas = &job.atlas->image;
+    int col = job.cell % DIAGRAM_COLUMNS, row = job.cell / DIAGRAM_COLUMNS;
+    Image image = ImageFromImage(
+        *atlas, (Rectangle){col * DIAGRAM_SIZE,
+                            atlas->height - (row + 1) * DIAGRAM_SIZE,
+                            DIAGRAM_SIZE, DIAGRAM_SIZE});
+    ImageFlipVertical(&image);
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%06zu.png", queue->directory, job.line);
+    bool success = ExportImage(image, path);
+    UnloadImage(image);
+
+    pthread_mutex_lock(&queue->mutex);
+    if (success) {
+      queue->written++;
+    } else {
+      fprintf(stderr, "error: could not write %s\n", path);
+      queue->failed++;
+    }
+
+    if (--job.atlas->remaining == 0) {
+      UnloadImage(job.atlas->image);
+      free(job.atlas);
+      queue->atlas_count--;
+      pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->mutex);
+  }
+}
+
+// Draw the boards into the cells of the target, laid out as in the window.
+static void draw_atlas(RenderTexture2D target, assets *assets,
+                       fen_position *positions, int count) {
+  move no_moves[4] = {
+      {POSITION_INV},
+      {POSITION_INV},
+      {POSITION_INV},
+      {POSITION_INV},
+  };
+  move no_move = {POSITION_INV, POSITION_INV, POSITION_INV};
+  gui_input input = {0};
+
+  BeginTextureMode(target);
+  ClearBackground(BACKGROUND_COLOR);
+
+  for (int cell = 0; cell < count; cell++) {
+    // The board is moved from its place in the window to its cell.
+    Camera2D camera = {
+        .offset = {(cell % DIAGRAM_COLUMNS) * DIAGRAM_SIZE - BOARD_RECT.x,
+                   (cell / DIAGRAM_COLUMNS) * DIAGRAM_SIZE - BOARD_RECT.y},
+        .zoom = 1,
+    };
+    BeginMode2D(camera);
+    gui_draw_board(assets, positions[cell].board, no_move, POSITION_INV,
+                   no_moves, 1, &input);
+    EndMode2D();
+  }
+
+  EndTextureMode();
+}
+
+// Hand the diagrams of a read back atlas to the encoders, waiting while too
+// many atlases are in flight. Returns false if out of memory.
+static bool queue_atlas(diagram_queue *queue, Image image, size_t *lines,
+                        int count) {
+  diagram_atlas *atlas = malloc(sizeof(diagram_atlas));
+  if (!atlas) {
+    fprintf(stderr, "error: malloc failed\n");
+    perror("malloc");
+    UnloadImage(image);
+    return false;
+  }
+  *atlas = (diagram_atlas){.image = image, .remaining = count};
+
+  size_t capacity = sizeof(queue->jobs) / sizeof(queue->jobs[0]);
+
+  pthread_mutex_lock(&queue->mutex);
+  for (int cell = 0; cell < count; cell++) {
+    queue->jobs[(queue->first_job + queue->job_count++) % capacity] =
+        (diagram_job){.atlas = atlas, .cell = cell, .line = lines[cell]};
+  }
+  queue->atlas_count++;
+  pthread_cond_broadcast(&queue->changed);
+  pthread_mutex_unlock(&queue->mutex);
+  return true;
+}
+
+bool diagram_render(const char *fens_path, const char *directory,
+                    assets *assets, int thread_count) {
+  int fd = open(fens_path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "error: could not open %s\n", fens_path);
+    perror("open");
+    return false;
+  }
+
+  struct stat stat;
+  if (fstat(fd, &stat) < 0 || stat.st_size == 0) {
+    fprintf(stderr, "error: %s is empty\n", fens_path);
+    close(fd);
+    return false;
+  }
+
+  size_t length = stat.st_size;
+  const char *text = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (text == MAP_FAILED) {
+    fprintf(stderr, "error: could not map %s\n", fens_path);
+    perror("mmap");
+    return false;
+  }
+
+  // raylib logs every texture read back and every image exported, which would
+  // bury the skipped lines.
+  SetTraceLogLevel(LOG_WARNING);
+
+  RenderTexture2D target = LoadRenderTexture(DIAGRAM_COLUMNS * DIAGRAM_SIZE,
+                                             DIAGRAM_ROWS * DIAGRAM_SIZE);
+
+  diagram_queue queue = {.directory = directory};
+  pthread_mutex_init(&queue.mutex, NULL);
+  pthread_cond_init(&queue.changed, NULL);
+
+  if (thread_count < 1)
+    thread_count = 1;
+  pthread_t threads[thread_count];
+  int started = 0;
+  for (; started < thread_count; started++) {
+    if (pthread_create(&threads[started], NULL, encode_worker, &queue)) {
+      fprintf(stderr, "error: pthread_create failed\n");
+      break;
+    }
+  }
+
+  bool success = started > 0;
+  size_t line = 0, skipped = 0;
+  uint64_t start_ns = timing_now_ns();
+
+  for (size_t offset = 0; success && offset < length;) {
+    // Lines that are not positions are skipped, so a batch can take several
+    // reads to fill.
+    fen_position positions[DIAGRAM_BATCH];
+    size_t lines[DIAGRAM_BATCH];
+    int count = 0;
+    while (count < DIAGRAM_BATCH && offset < length) {
+      fen_position loaded[DIAGRAM_BATCH];
+      size_t used;
+      size_t loaded_count = load_fens(text + offset, length - offset, loaded,
+                                      DIAGRAM_BATCH - count, &used);
+      offset += used;
+
+      for (size_t i = 0; i < loaded_count; i++) {
+        line++;
+        if (!loaded[i].valid) {
+          fprintf(stderr, "error: line %zu is not a FEN string\n", line);
+          skipped++;
+          continue;
+        }
+        lines[count] = line;
+        positions[count++] = loaded[i];
+      }
+    }
+    if (!count)
+      break;
+
+    draw_atlas(target, assets, positions, count);
+
+    // The encoders keep up with at most a few atlases, memory is bounded.
+    pthread_mutex_lock(&queue.mutex);
+    while (queue.atlas_count >= DIAGRAM_MAX_ATLASES)
+      pthread_cond_wait(&queue.changed, &queue.mutex);
+    pthread_mutex_unlock(&queue.mutex);
+
+    // Render textures are read back with an alpha channel, which is dropped
+    // before the diagrams are cropped so that the PNG files are opaque.
+    Image atlas = LoadImageFromTexture(target.texture);
+    ImageFormat(&atlas, PIXELFORMAT_UNCOMPRESSED_R8G8B8);
+
+    // Rendering the next batch overlaps with encoding this one.
+    success = queue_atlas(&queue, atlas, lines, count);
+  }
+
+  pthread_mutex_lock(&queue.mutex);
+  queue.done = true;
+  pthread_cond_broadcast(&queue.changed);
+  pthread_mutex_unlock(&queue.mutex);
+
+  for (int i = 0; i < started; i++)
+    pthread_join(threads[i], NULL);
+
+  uint64_t elapsed_ns = timing_now_ns() - start_ns;
+
+  pthread_cond_destroy(&queue.changed);
+  pthread_mutex_destroy(&queue.mutex);
+  UnloadRenderTexture(target);
+  munmap((void *)text, length);
+
+  printf("diagrams: %zu written, %zu lines skipped, %zu failed\n",
+         queue.written, skipped, queue.failed);
+  printf("diagrams: %.1f ms, %.0f diagrams/s\n", elapsed_ns / 1e6,
+         queue.written / (elapsed_ns / 1e9));
+  return success && !queue.failed;
+}
@@ -0,0 +1,41 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef DIAGRAM_H
+#define DIAGRAM_H
+
+#include "gui.h"
+
+#include <stdbool.h>
+
+// Diagrams are drawn side by side into an atlas of this many columns and rows,
+// which is read back from the GPU at once.
+#define DIAGRAM_COLUMNS 4
+#define DIAGRAM_ROWS 4
+#define DIAGRAM_BATCH (DIAGRAM_COLUMNS * DIAGRAM_ROWS)
+
+// Atlases read back and waiting to be encoded. Rendering waits for the
+// encoders once there are more.
+#define DIAGRAM_MAX_ATLASES 3
+
+// Write a PNG diagram of the board of every FEN line of the file at fens_path
+// into directory, named after the number of the line. Boards are drawn as in
+// the window, in batches into an offscreen texture, and encoded by
+// thread_count threads. Needs a window, which can be hidden, and the assets.
+bool diagram_render(const char *fens_path, const char *directory,
+                    assets *assets, int thread_count);
+
+#endif
@@ -26,7 +26,8 @@ bool load_fen(const char *fen, char *board, bool *turn) {
   for (; *fen != ' '; fen++) {
     switch (*fen) {
     case '/':
-      if (col != 8 || row >= 8)
+      // The last row is not followed by another.
+      if (col != 8 || row >= 7)
         return false;
 
       // Skip to next row.
@@ -40,7 +41,7 @@ bool load_fen(const char *fen, char *board, bool *turn) {
       // digits right next to each other. However checking this seems
       // unnecessary.
       int spaces = *fen - '0';
-      if (col + spaces > 8)
+      if (row > 7 || col + spaces > 8)
         return false;
       while (spaces--)
         board[to_position(row, col++)] = ' ';
@@ -88,21 +89,30 @@ bool load_fen(const char *fen, char *board, bool *turn) {
 
 // Copy-pasted and slightly modified from JazzInSea source code.
 char *get_fen_string(char *fen, char *board, bool turn) {
+  // Empty squares are counted and written once the run ends, never looking
+  // back before the start of the buffer.
+  int empty = 0;
+
   for (int position = 0; position < 64; position++) {
     char piece = board[position];
 
     if (piece == ' ') {
-      if (*(fen - 1) >= '1' && *(fen - 1) <= '8') {
-        (*(fen - 1))++;
-      } else {
-        *fen++ = '1';
-      }
+      empty++;
     } else {
+      if (empty)
+        *fen++ = '0' + empty;
+      empty = 0;
       *fen++ = piece;
     }
 
-    if (position % 8 == 7 && position / 8 < 7)
-      *fen++ = '/';
+    if (position % 8 == 7) {
+      if (empty)
+        *fen++ = '0' + empty;
+      empty = 0;
+
+      if (position / 8 < 7)
+        *fen++ = '/';
+    }
   }
 
   *fen++ = ' ';
@@ -0,0 +1,393 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "fenbulk.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FEN_X86
+#include <immintrin.h>
+#endif
+
+// The shortest and longest strings load_fen accepts, such as 8/8/8/8/8/8/8/8 w
+// and a board of 64 pieces with 7 slashes.
+#define MIN_FEN_LENGTH 17
+#define MAX_FEN_LENGTH 73
+
+// Lines are classified in a padded copy, a whole number of vectors long.
+#define LINE_BUFFER_SIZE 96
+
+const char *FEN_PARSER_NAMES[FEN_PARSER_COUNT] = {
+    [FEN_PARSER_SCALAR] = "scalar",
+    [FEN_PARSER_SSE2] = "sse2",
+    [FEN_PARSER_AVX2] = "avx2",
+};
+
+// Bit i of a mask is set if byte i of the line is in the class. Two words
+// cover LINE_BUFFER_SIZE bytes without needing 128 bit integers, which 32 bit
+// targets do not have.
+typedef struct {
+  uint64_t low;
+  uint64_t high;
+} line_mask;
+
+// What the parsers find out about the bytes of a line, up to LINE_BUFFER_SIZE
+// bytes.
+typedef struct {
+  line_mask zero;
+  line_mask space;
+  line_mask slash;
+  line_mask allowed;
+  line_mask piece;
+
+  // The square of every byte: the number of squares the bytes before it
+  // cover, a piece covering one and a digit as many as it tells. As rows are 8
+  // squares wide, a piece is on its square of the board if the line is valid.
+  // Sums stop at 255, which is beyond any valid square.
+  uint8_t square[LINE_BUFFER_SIZE];
+} line_scan;
+
+// Scan a line of length bytes. Vectors are read as a whole, up to
+// LINE_BUFFER_SIZE bytes.
+typedef void (*scan_function)(const char *line, size_t length,
+                              line_scan *scan);
+
+// Set the bits of a vector block in a mask. Blocks are at most 32 bytes, so
+// they never straddle the two words.
+static inline void mask_add(line_mask *mask, uint64_t bits, int shift) {
+  if (shift < 64)
+    mask->low |= bits << shift;
+  else
+    mask->high |= bits << (shift - 64);
+}
+
+static inline line_mask mask_and(line_mask first, line_mask second) {
+  return (line_mask){first.low & second.low, first.high & second.high};
+}
+
+static inline bool mask_empty(line_mask mask) {
+  return !mask.low && !mask.high;
+}
+
+static inline bool mask_equal(line_mask first, line_mask second) {
+  return first.low == second.low && first.high == second.high;
+}
+
+static int mask_first(line_mask mask) {
+  return mask.low ? __builtin_ctzll(mask.low)
+                  : 64 + __builtin_ctzll(mask.high);
+}
+
+static inline void mask_clear_first(line_mask *mask) {
+  if (mask->low)
+    mask->low &= mask->low - 1;
+  else
+    mask->high &= mask->high - 1;
+}
+
+static int mask_count(line_mask mask) {
+  return __builtin_popcountll(mask.low) + __builtin_popcountll(mask.high);
+}
+
+static inline line_mask mask_below(int bit) {
+  if (bit < 64)
+    return (line_mask){((uint64_t)1 << bit) - 1, 0};
+  return (line_mask){UINT64_MAX, ((uint64_t)1 << (bit - 64)) - 1};
+}
+
+static void scan_scalar(const char *line, size_t length, line_scan *scan) {
+  memset(scan, 0, offsetof(line_scan, square));
+
+  int square = 0;
+  for (size_t i = 0; i < length; i++) {
+    scan->square[i] = square < 255 ? square : 255;
+
+    switch (line[i]) {
+    case '\0':
+      mask_add(&scan->zero, 1, i);
+      break;
+    case ' ':
+      mask_add(&scan->space, 1, i);
+      break;
+    case '/':
+      mask_add(&scan->slash, 1, i);
+      mask_add(&scan->allowed, 1, i);
+      break;
+    case '1' ... '8':
+      mask_add(&scan->allowed, 1, i);
+      square += line[i] - '0';
+      break;
+    case 'P':
+    case 'N':
+    case 'p':
+    case 'n':
+      mask_add(&scan->piece, 1, i);
+      mask_add(&scan->allowed, 1, i);
+      square++;
+      break;
+    }
+  }
+}
+
+#ifdef FEN_X86
+// SSE2 is not always enabled on 32 bit targets, so the functions using it are
+// compiled for it and only called if the processor supports it.
+
+// Turn 16 widths into the squares of their bytes, carrying the squares of the
+// bytes before them.
+__attribute__((target("sse2"))) static inline __m128i
+squares_sse2(__m128i widths, __m128i *carry) {
+  __m128i sums = _mm_adds_epu8(widths, _mm_slli_si128(widths, 1));
+  sums = _mm_adds_epu8(sums, _mm_slli_si128(sums, 2));
+  sums = _mm_adds_epu8(sums, _mm_slli_si128(sums, 4));
+  sums = _mm_adds_epu8(sums, _mm_slli_si128(sums, 8));
+  sums = _mm_adds_epu8(sums, *carry);
+
+  // The last sum is carried to every byte of the next block.
+  *carry = _mm_shuffle_epi32(
+      _mm_shufflehi_epi16(_mm_srli_epi16(sums, 8), _MM_SHUFFLE(3, 3, 3, 3)),
+      _MM_SHUFFLE(3, 3, 3, 3));
+  *carry = _mm_or_si128(*carry, _mm_slli_epi16(*carry, 8));
+
+  return _mm_subs_epu8(sums, widths);
+}
+
+// Pieces are one square wide and digits as wide as they tell.
+__attribute__((target("sse2"))) static inline __m128i
+widths_sse2(__m128i bytes, __m128i digit, __m128i piece) {
+  return _mm_or_si128(
+      _mm_and_si128(digit, _mm_sub_epi8(bytes, _mm_set1_epi8('0'))),
+      _mm_and_si128(piece, _mm_set1_epi8(1)));
+}
+
+__attribute__((target("sse2"))) static void
+scan_sse2(const char *line, size_t length, line_scan *scan) {
+  memset(scan, 0, offsetof(line_scan, square));
+  __m128i carry = _mm_setzero_si128();
+
+  for (int block = 0; block < LINE_BUFFER_SIZE / 16; block++) {
+    __m128i bytes = _mm_loadu_si128((const __m128i *)line + block);
+
+    // Digits are the bytes at most 7 above '1', compared unsigned.
+    __m128i offset = _mm_sub_epi8(bytes, _mm_set1_epi8('1'));
+    __m128i digit =
+        _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(7)), offset);
+    __m128i piece =
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('P')),
+                                  _mm_cmpeq_epi8(bytes, _mm_set1_epi8('N'))),
+                     _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('p')),
+                                  _mm_cmpeq_epi8(bytes, _mm_set1_epi8('n'))));
+    __m128i slash = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('/'));
+
+    int shift = block * 16;
+    mask_add(&scan->zero,
+             (uint16_t)_mm_movemask_epi8(
+                 _mm_cmpeq_epi8(bytes, _mm_setzero_si128())),
+             shift);
+    mask_add(&scan->space,
+             (uint16_t)_mm_movemask_epi8(
+                 _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '))),
+             shift);
+    mask_add(&scan->slash, (uint16_t)_mm_movemask_epi8(slash), shift);
+    mask_add(&scan->piece, (uint16_t)_mm_movemask_epi8(piece), shift);
+    mask_add(&scan->allowed,
+             (uint16_t)_mm_movemask_epi8(
+                 _mm_or_si128(_mm_or_si128(digit, piece), slash)),
+             shift);
+
+    _mm_storeu_si128(
+        (__m128i *)scan->square + block,
+        squares_sse2(widths_sse2(bytes, digit, piece), &carry));
+  }
+}
+
+__attribute__((target("avx2"))) static void
+scan_avx2(const char *line, size_t length, line_scan *scan) {
+  memset(scan, 0, offsetof(line_scan, square));
+  __m128i carry = _mm_setzero_si128();
+
+  for (int block = 0; block < LINE_BUFFER_SIZE / 32; block++) {
+    __m256i bytes = _mm256_loadu_si256((const __m256i *)line + block);
+
+    __m256i offset = _mm256_sub_epi8(bytes, _mm256_set1_epi8('1'));
+    __m256i digit = _mm256_cmpeq_epi8(
+        _mm256_min_epu8(offset, _mm256_set1_epi8(7)), offset);
+    __m256i piece = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('P')),
+                        _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('N'))),
+        _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('p')),
+                        _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('n'))));
+    __m256i slash = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('/'));
+
+    int shift = block * 32;
+    mask_add(&scan->zero,
+             (uint32_t)_mm256_movemask_epi8(
+                 _mm256_cmpeq_epi8(bytes, _mm256_setzero_si256())),
+             shift);
+    mask_add(&scan->space,
+             (uint32_t)_mm256_movemask_epi8(
+                 _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' '))),
+             shift);
+    mask_add(&scan->slash, (uint32_t)_mm256_movemask_epi8(slash), shift);
+    mask_add(&scan->piece, (uint32_t)_mm256_movemask_epi8(piece), shift);
+    mask_add(&scan->allowed,
+             (uint32_t)_mm256_movemask_epi8(
+                 _mm256_or_si256(_mm256_or_si256(digit, piece), slash)),
+             shift);
+
+    // The sums carry across the halves, which are summed one after the other.
+    __m256i widths = _mm256_or_si256(
+        _mm256_and_si256(digit, _mm256_sub_epi8(bytes, _mm256_set1_epi8('0'))),
+        _mm256_and_si256(piece, _mm256_set1_epi8(1)));
+    __m128i *squares = (__m128i *)scan->square + block * 2;
+    _mm_storeu_si128(squares,
+                     squares_sse2(_mm256_castsi256_si128(widths), &carry));
+    _mm_storeu_si128(
+        squares + 1,
+        squares_sse2(_mm256_extracti128_si256(widths, 1), &carry));
+  }
+}
+#endif
+
+static const scan_function SCAN_FUNCTIONS[FEN_PARSER_COUNT] = {
+    [FEN_PARSER_SCALAR] = scan_scalar,
+#ifdef FEN_X86
+    [FEN_PARSER_SSE2] = scan_sse2,
+    [FEN_PARSER_AVX2] = scan_avx2,
+#endif
+};
+
+bool fen_parser_supported(fen_parser parser) {
+  switch (parser) {
+  case FEN_PARSER_SCALAR:
+    return true;
+#ifdef FEN_X86
+  case FEN_PARSER_SSE2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+  case FEN_PARSER_AVX2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return false;
+  }
+}
+
+fen_parser fen_parser_best() {
+  fen_parser best = FEN_PARSER_SCALAR;
+  for (fen_parser parser = FEN_PARSER_SSE2; parser < FEN_PARSER_COUNT;
+       parser++) {
+    if (fen_parser_supported(parser))
+      best = parser;
+  }
+  return best;
+}
+
+// Load a line, which can be read up to LINE_BUFFER_SIZE bytes if readable is
+// set. Bytes after the line are ignored.
+static bool load_line(const char *line, size_t length, bool readable,
+                      fen_position *position, scan_function scan_line) {
+  // load_fen stops at the end of the string.
+  if (length > MAX_FEN_LENGTH) {
+    const char *zero = memchr(line, '\0', length);
+    if (!zero || zero - line > MAX_FEN_LENGTH)
+      return false;
+    length = zero - line;
+  }
+
+  // Lines near the end of the text are copied to be scanned.
+  char buffer[LINE_BUFFER_SIZE];
+  if (!readable) {
+    memcpy(buffer, line, length);
+    memset(buffer + length, 0, sizeof(buffer) - length);
+    line = buffer;
+  }
+
+  line_scan scan;
+  scan_line(line, length, &scan);
+
+  line_mask zero = mask_and(scan.zero, mask_below(length));
+  if (!mask_empty(zero))
+    length = mask_first(zero);
+  if (length < MIN_FEN_LENGTH)
+    return false;
+
+  // The board ends at the first space, and only the turn follows it.
+  line_mask space = mask_and(scan.space, mask_below(length));
+  if (mask_empty(space))
+    return false;
+  int board_end = mask_first(space);
+  if (board_end + 2 != length ||
+      (line[board_end + 1] != 'w' && line[board_end + 1] != 'b'))
+    return false;
+
+  line_mask board_mask = mask_below(board_end);
+  line_mask slash = mask_and(scan.slash, board_mask);
+  if (!mask_equal(mask_and(scan.allowed, board_mask), board_mask) ||
+      mask_count(slash) != 7 || scan.square[board_end] != 64)
+    return false;
+
+  // Every row is 8 squares wide if the rows end on the right squares.
+  for (int row = 1; row < 8; row++) {
+    if (scan.square[mask_first(slash)] != row * 8)
+      return false;
+    mask_clear_first(&slash);
+  }
+
+  memset(position->board, ' ', sizeof(position->board));
+  for (line_mask piece = mask_and(scan.piece, board_mask); !mask_empty(piece);
+       mask_clear_first(&piece)) {
+    int i = mask_first(piece);
+    position->board[scan.square[i]] = line[i];
+  }
+
+  position->turn = line[board_end + 1] == 'w';
+  return true;
+}
+
+size_t load_fens_with(fen_parser parser, const char *text, size_t length,
+                      fen_position *positions, size_t max_count,
+                      size_t *used) {
+  scan_function scan_line = SCAN_FUNCTIONS[parser];
+
+  size_t count = 0, offset = 0;
+  while (count < max_count && offset < length) {
+    const char *line = text + offset;
+    const char *newline = memchr(line, '\n', length - offset);
+    size_t line_length = newline ? (size_t)(newline - line) : length - offset;
+
+    positions[count].valid =
+        load_line(line, line_length, length - offset >= LINE_BUFFER_SIZE,
+                  &positions[count], scan_line);
+    count++;
+    offset += line_length + (newline != NULL);
+  }
+
+  if (used)
+    *used = offset;
+  return count;
+}
+
+size_t load_fens(const char *text, size_t length, fen_position *positions,
+                 size_t max_count, size_t *used) {
+  return load_fens_with(fen_parser_best(), text, length, positions, max_count,
+                        used);
+}
@@ -0,0 +1,59 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef FENBULK_H
+#define FENBULK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// The implementations of the bulk parser. They all accept exactly the lines
+// load_fen accepts, and differ only in how the characters are classified.
+typedef enum {
+  FEN_PARSER_SCALAR,
+  FEN_PARSER_SSE2,
+  FEN_PARSER_AVX2,
+  FEN_PARSER_COUNT,
+} fen_parser;
+
+extern const char *FEN_PARSER_NAMES[FEN_PARSER_COUNT];
+
+typedef struct {
+  char board[64];
+  bool turn;
+
+  // Whether load_fen accepts the line, the board is undefined otherwise.
+  bool valid;
+} fen_position;
+
+// Whether the processor can run the parser.
+bool fen_parser_supported(fen_parser parser);
+
+// The fastest parser the processor can run.
+fen_parser fen_parser_best();
+
+// Load up to max_count newline separated FEN strings from text, every line as
+// load_fen would load it. Returns the number of lines loaded and sets used to
+// the bytes they took, so that a longer text can be loaded in batches.
+size_t load_fens(const char *text, size_t length, fen_position *positions,
+                 size_t max_count, size_t *used);
+
+// Like load_fens, with a given parser that must be supported.
+size_t load_fens_with(fen_parser parser, const char *text, size_t length,
+                      fen_position *positions, size_t max_count,
+                      size_t *used);
+
+#endif
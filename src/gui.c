@@ -38,14 +38,20 @@ const Color CIRCLE_CAPTURE_COLOR = (Color){0xff, 0x00, 0x00, 0x80};
 const Color LAST_MOVE_FROM_COLOR = (Color){0x66, 0xff, 0xff, 0x80};
 const Color LAST_MOVE_TO_COLOR = (Color){0x66, 0xff, 0xff, 0x60};
 
+const Color HISTORY_CURSOR_COLOR = (Color){0x66, 0xff, 0xff, 0x60};
+const int HISTORY_LINE_HEIGHT = 20;
+
 const Rectangle HISTORY_RECT = (Rectangle){900, 80, 200, 200};
+const Rectangle ANALYSIS_RECT = (Rectangle){900, 370, 200, 220};
+const Rectangle LATENCY_RECT = (Rectangle){900, 620, 200, 100};
 const Rectangle BOARD_RECT =
     (Rectangle){50, 50, 8 * GRID_SQUARE_SIZE, 8 * GRID_SQUARE_SIZE};
 
 const int WINDOW_WIDTH = 1150;
 const int WINDOW_HEIGHT = 900;
 
-const int MOVE_ANIM_FRAMES = 20;
+const int MOVE_ANIM_MS = 220;
+const int IDLE_FRAME_RATE = 30;
 
 Vector2 pos_to_window_vec(int pos) {
   return (Vector2){to_col(pos) * GRID_SQUARE_SIZE + BOARD_RECT.x,
@@ -103,6 +109,52 @@ void gui_init() {
   SetTargetFPS(90);
 }
 
+int gui_refresh_rate() {
+  int rate = GetMonitorRefreshRate(GetCurrentMonitor());
+
+  // Some platforms can not tell the rate.
+  return rate > 0 ? rate : 60;
+}
+
+static const int INPUT_KEYS[INPUT_KEY_COUNT] = {
+    [INPUT_KEY_LEFT] = KEY_LEFT,   [INPUT_KEY_RIGHT] = KEY_RIGHT,
+    [INPUT_KEY_HOME] = KEY_HOME,   [INPUT_KEY_END] = KEY_END,
+    [INPUT_KEY_SPACE] = KEY_SPACE, [INPUT_KEY_ANALYSIS] = KEY_A,
+    [INPUT_KEY_LATENCY] = KEY_F3,
+};
+
+void gui_input_collect(gui_input *input) {
+  Vector2 mouse = GetMousePosition();
+  bool moved = mouse.x != input->mouse.x || mouse.y != input->mouse.y;
+  bool event = false;
+
+  // Moving the mouse only matters while a piece is dragged.
+  if (IsMouseButtonDown(MOUSE_BUTTON_LEFT) && moved)
+    event = true;
+
+  if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
+    event = input->mouse_pressed = true;
+  if (IsMouseButtonReleased(MOUSE_BUTTON_LEFT))
+    event = input->mouse_released = true;
+
+  for (int key = 0; key < INPUT_KEY_COUNT; key++) {
+    if (IsKeyPressed(INPUT_KEYS[key]))
+      event = input->keys_pressed[key] = true;
+  }
+
+  input->mouse = mouse;
+  input->mouse_down = IsMouseButtonDown(MOUSE_BUTTON_LEFT);
+
+  if (event && !input->event_ns)
+    input->event_ns = timing_now_ns();
+}
+
+void gui_input_clear(gui_input *input) {
+  input->mouse_pressed = input->mouse_released = false;
+  memset(input->keys_pressed, 0, sizeof(input->keys_pressed));
+  input->event_ns = 0;
+}
+
 void gui_load_assets(assets *assets) {
   // Create the board grid texture.
   {
@@ -188,9 +240,208 @@ void gui_unload_assets(assets *assets) {
   UnloadTexture(assets->black_knight_texture);
 }
 
-void gui_make_move(jis_process *process, assets *gui_assets, char *board,
+bool gui_make_move(jis_process *process, assets *gui_assets, char *board,
                    bool *board_turn, int *board_status, char *move_string,
-                   move *last_move) {
-  jis_make_move(process, board, board_turn, board_status, move_string);
+                   move *last_move, history *history, game_writer *writer) {
+  if (!jis_make_move(process, board, board_turn, board_status, move_string))
+    return false;
+
   *last_move = jis_desc_move(process, move_string);
+  if (!is_valid(last_move->from) ||
+      !history_push(history, *last_move, board, *board_turn, *board_status))
+    return false;
+
+  // Stream the move to the game archive, if recording.
+  return !writer || game_writer_add(writer, *last_move, *board_status);
+}
+
+void gui_draw_board(assets *assets, const char *board, move last_move,
+                    int selected_piece, move available_moves[4],
+                    float anim_progress, const gui_input *input) {
+  DrawTextureRec(assets->grid_texture,
+                 (Rectangle){0, 0, assets->grid_texture.width,
+                             assets->grid_texture.height},
+                 (Vector2){BOARD_RECT.x, BOARD_RECT.y}, WHITE);
+
+  if (is_valid(selected_piece) && selected_piece != last_move.to) {
+    DrawRectangleRec(pos_to_window_rect(selected_piece), GRID_HELD_COLOR);
+  }
+
+  if (is_valid(last_move.from)) {
+    DrawRectangleRec(pos_to_window_rect(last_move.from), LAST_MOVE_FROM_COLOR);
+    DrawRectangleRec(pos_to_window_rect(last_move.to), LAST_MOVE_TO_COLOR);
+  }
+
+  // Rows are inverted, unlike how jazz-in-sea represents them.
+  for (int position = 0; position < 64; position++) {
+    Texture2D *texture;
+    switch (board[position]) {
+    case 'P':
+      texture = &assets->white_pawn_texture;
+      break;
+    case 'N':
+      texture = &assets->white_knight_texture;
+      break;
+    case 'p':
+      texture = &assets->black_pawn_texture;
+      break;
+    case 'n':
+      texture = &assets->black_knight_texture;
+      break;
+    default:
+      continue;
+    }
+
+    Rectangle rect;
+    if (last_move.to == position && anim_progress < 1) {
+
+      Rectangle start_rect = pos_to_window_rect(last_move.from);
+      Rectangle end_rect = pos_to_window_rect(last_move.to);
+
+      rect = anim_linint(start_rect, end_rect, quad_interpolate(anim_progress));
+
+    } else if (position == selected_piece && input->mouse_down) {
+      int x = (int)(input->mouse.x) - GRID_SQUARE_SIZE / 2;
+      int y = (int)(input->mouse.y) - GRID_SQUARE_SIZE / 2;
+      rect = (Rectangle){x, y, GRID_SQUARE_SIZE, GRID_SQUARE_SIZE};
+
+    } else {
+      rect = pos_to_window_rect(position);
+    }
+
+    // Upsize the texture to the square size and draw it.
+    DrawTexturePro(*texture,
+                   (Rectangle){0, 0, texture->width, texture->height}, rect,
+                   (Vector2){0, 0}, 0, WHITE);
+  }
+
+  // Draw indicators to available squares.
+  for (int i = 0; i < 4; i++) {
+    move move = available_moves[i];
+
+    if (!is_valid(move.from))
+      continue;
+
+    DrawTexturePro(assets->circle_texture,
+                   (Rectangle){0, 0, assets->circle_texture.width,
+                               assets->circle_texture.height},
+                   pos_to_window_rect(move.to), (Vector2){0, 0}, 0,
+                   CIRCLE_TO_COLOR);
+
+    if (is_valid(move.capture))
+      DrawTexturePro(assets->circle_texture,
+                     (Rectangle){0, 0, assets->circle_texture.width,
+                                 assets->circle_texture.height},
+                     pos_to_window_rect(move.capture), (Vector2){0, 0}, 0,
+                     CIRCLE_CAPTURE_COLOR);
+  }
+}
+
+void gui_draw_status(int status, bool turn, bool lost_on_time) {
+  const char *status_text = "<invalid>";
+  switch (status >> 4) {
+  case 0:
+    if (turn)
+      status_text = "White to play";
+    else
+      status_text = "Black to play";
+    break;
+  case 1:
+    status_text = "Draw";
+    break;
+  case 2:
+    status_text = lost_on_time ? "White wins on time" : "White wins";
+    break;
+  case 3:
+    status_text = lost_on_time ? "Black wins on time" : "Black wins";
+    break;
+  }
+  DrawText(status_text, 900, 50, 30, WHITE);
+}
+
+// The first row of the move list that is visible, so that the cursor is always
+// on the screen.
+static size_t history_first_row(history *history) {
+  size_t visible_rows = HISTORY_RECT.height / HISTORY_LINE_HEIGHT;
+  size_t cursor_row = history->cursor ? (history->cursor - 1) / 2 : 0;
+  return cursor_row < visible_rows ? 0 : cursor_row - visible_rows + 1;
+}
+
+void gui_draw_history(history *history) {
+  size_t visible_rows = HISTORY_RECT.height / HISTORY_LINE_HEIGHT;
+  size_t first_row = history_first_row(history);
+
+  // Every row holds two plies, following the move number.
+  for (size_t row = first_row;
+       row < first_row + visible_rows && row * 2 < history->length; row++) {
+    int y = HISTORY_RECT.y + (row - first_row) * HISTORY_LINE_HEIGHT;
+    DrawText(TextFormat("%zu.", row + 1), HISTORY_RECT.x, y,
+             HISTORY_LINE_HEIGHT, GRAY);
+
+    for (size_t ply = row * 2; ply < row * 2 + 2 && ply < history->length;
+         ply++) {
+      int x = HISTORY_RECT.x + 50 + (ply % 2) * 75;
+
+      if (ply + 1 == history->cursor)
+        DrawRectangleRec((Rectangle){x - 4, y, 70, HISTORY_LINE_HEIGHT},
+                         HISTORY_CURSOR_COLOR);
+
+      DrawText(history->entries[ply].move.string, x, y, HISTORY_LINE_HEIGHT,
+               WHITE);
+    }
+  }
+}
+
+int gui_history_ply_at(history *history, Vector2 vec) {
+  if (!CheckCollisionPointRec(vec, HISTORY_RECT))
+    return -1;
+
+  size_t row = history_first_row(history) +
+               (size_t)(vec.y - HISTORY_RECT.y) / HISTORY_LINE_HEIGHT;
+  int column = (vec.x - HISTORY_RECT.x - 46) / 75;
+  if (column < 0 || column > 1)
+    return -1;
+
+  // The ply after the clicked move was made.
+  size_t ply = row * 2 + column + 1;
+  return ply <= history->length ? ply : -1;
+}
+
+void gui_draw_analysis(analysis *analysis) {
+  DrawText("Analysis", ANALYSIS_RECT.x, ANALYSIS_RECT.y, HISTORY_LINE_HEIGHT,
+           GRAY);
+
+  analysis_candidate ranking[ANALYSIS_MAX_CANDIDATES];
+  size_t visible_rows = ANALYSIS_RECT.height / HISTORY_LINE_HEIGHT - 1;
+  size_t count = analysis_ranking(analysis, ranking, visible_rows);
+
+  for (size_t i = 0; i < count; i++) {
+    int y = ANALYSIS_RECT.y + (i + 1) * HISTORY_LINE_HEIGHT;
+    DrawText(ranking[i].move.string, ANALYSIS_RECT.x, y, HISTORY_LINE_HEIGHT,
+             WHITE);
+
+    if (ranking[i].done)
+      DrawText(TextFormat("%+d", ranking[i].score), ANALYSIS_RECT.x + 75, y,
+               HISTORY_LINE_HEIGHT, WHITE);
+    else
+      DrawText("...", ANALYSIS_RECT.x + 75, y, HISTORY_LINE_HEIGHT, GRAY);
+  }
+}
+
+void gui_draw_latency(const latency_samples *latency) {
+  static const double fractions[] = {0.5, 0.9, 0.99, 1};
+  static const char *labels[] = {"p50", "p90", "p99", "max"};
+
+  uint64_t results[4];
+  size_t count = latency_percentiles(latency, fractions, results, 4);
+
+  DrawText(TextFormat("Poll to frame (%zu)", count), LATENCY_RECT.x,
+           LATENCY_RECT.y, HISTORY_LINE_HEIGHT, GRAY);
+
+  for (int i = 0; i < 4; i++) {
+    int y = LATENCY_RECT.y + (i + 1) * HISTORY_LINE_HEIGHT;
+    DrawText(labels[i], LATENCY_RECT.x, y, HISTORY_LINE_HEIGHT, WHITE);
+    DrawText(TextFormat("%.1f ms", results[i] / 1e6), LATENCY_RECT.x + 75, y,
+             HISTORY_LINE_HEIGHT, WHITE);
+  }
 }
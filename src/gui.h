@@ -17,10 +17,16 @@ jis-gui. If not, see <https://www.gnu.org/licenses/>.
 #ifndef GUI_H
 #define GUI_H
 
+#include "analysis.h"
+#include "history.h"
 #include "jis_process.h"
+#include "record.h"
+#include "timing.h"
 
 #include <raylib.h>
 
+#include <stdint.h>
+
 extern const char *GUI_TITLE;
 
 extern const int GRID_SQUARE_SIZE;
@@ -37,13 +43,19 @@ extern const Color CIRCLE_CAPTURE_COLOR;
 extern const Color LAST_MOVE_FROM_COLOR;
 extern const Color LAST_MOVE_TO_COLOR;
 
+extern const Color HISTORY_CURSOR_COLOR;
+extern const int HISTORY_LINE_HEIGHT;
+
 extern const Rectangle HISTORY_RECT;
+extern const Rectangle ANALYSIS_RECT;
+extern const Rectangle LATENCY_RECT;
 extern const Rectangle BOARD_RECT;
 
 extern const int WINDOW_WIDTH;
 extern const int WINDOW_HEIGHT;
 
-extern const int MOVE_ANIM_FRAMES;
+extern const int MOVE_ANIM_MS;
+extern const int IDLE_FRAME_RATE;
 
 typedef struct {
   Texture2D grid_texture;
@@ -55,6 +67,33 @@ typedef struct {
   Texture2D black_knight_texture;
 } assets;
 
+// The keys the main loop reacts to.
+typedef enum {
+  INPUT_KEY_LEFT,
+  INPUT_KEY_RIGHT,
+  INPUT_KEY_HOME,
+  INPUT_KEY_END,
+  INPUT_KEY_SPACE,
+  INPUT_KEY_ANALYSIS,
+  INPUT_KEY_LATENCY,
+  INPUT_KEY_COUNT,
+} input_key;
+
+// Input gathered over a frame. Raylib forgets presses once events are polled
+// again, so every poll is collected into this and the frame reads the result.
+typedef struct {
+  Vector2 mouse;
+  bool mouse_down;
+  bool mouse_pressed;
+  bool mouse_released;
+  bool keys_pressed[INPUT_KEY_COUNT];
+
+  // When the first event of the frame was collected, 0 if there was none.
+  // This is when raylib polled it, after the wait for the frame, as the time
+  // the system delivered it is not known.
+  uint64_t event_ns;
+} gui_input;
+
 Vector2 pos_to_window_vec(int pos);
 Vector2 pos_to_window_vec_center(int pos);
 Rectangle pos_to_window_rect(int pos);
@@ -70,11 +109,43 @@ Texture2D load_texture_rel(const char *root_path, const char *rel_path);
 
 void gui_init();
 
+// Return the refresh rate of the display of the window.
+int gui_refresh_rate();
+
+// Merge the state of the last poll of events into input.
+void gui_input_collect(gui_input *input);
+
+// Forget the events of the finished frame.
+void gui_input_clear(gui_input *input);
+
 void gui_load_assets(assets *assets);
 void gui_unload_assets(assets *assets);
 
-void gui_make_move(jis_process *process, assets *gui_assets, char *board,
+// Make the move through the engine, and append it to the history and to the
+// archive if recording. Returns false if any of them failed.
+bool gui_make_move(jis_process *process, assets *gui_assets, char *board,
                    bool *board_turn, int *board_status, char *move_string,
-                   move *last_move);
+                   move *last_move, history *history, game_writer *writer);
+
+// Draw the board with its pieces, the last move animated until anim_progress
+// reaches 1 and the selected piece following the mouse while it is held.
+void gui_draw_board(assets *assets, const char *board, move last_move,
+                    int selected_piece, move available_moves[4],
+                    float anim_progress, const gui_input *input);
+
+// Draw the side to move or the result of the game.
+void gui_draw_status(int status, bool turn, bool lost_on_time);
+
+// Draw the move list into HISTORY_RECT.
+void gui_draw_history(history *history);
+
+// Return the ply of the move under vec in the move list, or -1.
+int gui_history_ply_at(history *history, Vector2 vec);
+
+// Draw the ranked candidate moves into ANALYSIS_RECT.
+void gui_draw_analysis(analysis *analysis);
+
+// Draw the distribution of input latencies into LATENCY_RECT.
+void gui_draw_latency(const latency_samples *latency);
 
 #endif
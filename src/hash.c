@@ -0,0 +1,111 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "hash.h"
+#include "position.h"
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Keys for every piece on every square, followed by the key of white to move.
+static uint64_t keys[4 * 64 + 1];
+static bool keys_ready = false;
+
+static int piece_index(char piece) {
+  switch (piece) {
+  case 'P':
+    return 0;
+  case 'N':
+    return 1;
+  case 'p':
+    return 2;
+  case 'n':
+    return 3;
+  default:
+    return -1;
+  }
+}
+
+// The keys must be the same on every run since hashes are stored in files, so
+// they are generated from a fixed seed.
+static void init_keys() {
+  uint64_t state = 0x4a495347554921;
+  for (int i = 0; i < 4 * 64 + 1; i++) {
+    // splitmix64
+    uint64_t z = (state += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    keys[i] = z ^ (z >> 31);
+  }
+  keys_ready = true;
+}
+
+uint64_t board_hash(const char *board, bool turn) {
+  if (!keys_ready)
+    init_keys();
+
+  uint64_t hash = turn ? keys[4 * 64] : 0;
+  for (int position = 0; position < 64; position++) {
+    int index = piece_index(board[position]);
+    if (index >= 0)
+      hash ^= keys[index * 64 + position];
+  }
+  return hash;
+}
+
+int transform_position(int transform, int position) {
+  if (!is_valid(position))
+    return position;
+
+  int row = to_row(position);
+  int col = to_col(position);
+  if (transform & TRANSFORM_MIRROR)
+    col = 7 - col;
+  if (transform & TRANSFORM_COLOUR)
+    row = 7 - row;
+  return to_position(row, col);
+}
+
+void transform_board(int transform, const char *board, bool turn,
+                     char *result_board, bool *result_turn) {
+  for (int position = 0; position < 64; position++) {
+    char piece = board[position];
+    if (transform & TRANSFORM_COLOUR)
+      piece = isupper(piece) ? tolower(piece) : toupper(piece);
+    result_board[transform_position(transform, position)] = piece;
+  }
+
+  *result_turn = transform & TRANSFORM_COLOUR ? !turn : turn;
+}
+
+uint64_t board_hash_canonical(const char *board, bool turn, int *transform) {
+  uint64_t best = board_hash(board, turn);
+  *transform = 0;
+
+  for (int i = 1; i < TRANSFORM_COUNT; i++) {
+    char transformed[64];
+    bool transformed_turn;
+    transform_board(i, board, turn, transformed, &transformed_turn);
+
+    uint64_t hash = board_hash(transformed, transformed_turn);
+    if (hash < best) {
+      best = hash;
+      *transform = i;
+    }
+  }
+  return best;
+}
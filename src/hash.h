@@ -0,0 +1,44 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Symmetries of the board. Mirroring flips the columns, swapping the colours
+// flips the rows, the piece colours and the side to move.
+#define TRANSFORM_MIRROR 1
+#define TRANSFORM_COLOUR 2
+#define TRANSFORM_COUNT 4
+
+// Zobrist hash of a board position.
+uint64_t board_hash(const char *board, bool turn);
+
+// Apply a transform to a board position.
+void transform_board(int transform, const char *board, bool turn,
+                     char *result_board, bool *result_turn);
+
+// Apply a transform to a position. Transforms are their own inverses.
+int transform_position(int transform, int position);
+
+// Hash the position in the frame where it hashes the lowest, so that
+// symmetrical positions share the same hash. The used transform is stored in
+// transform.
+uint64_t board_hash_canonical(const char *board, bool turn, int *transform);
+
+#endif
@@ -0,0 +1,191 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "history.h"
+#include "jis_process.h"
+#include "position.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Grow a dynamic array to hold at least one more element.
+static bool grow(void **array, size_t *capacity, size_t length, size_t size) {
+  if (length < *capacity)
+    return true;
+
+  size_t new_capacity = *capacity ? *capacity * 2 : 64;
+  void *new_array = realloc(*array, new_capacity * size);
+  if (!new_array) {
+    fprintf(stderr, "error: realloc failed\n");
+    perror("realloc");
+    return false;
+  }
+
+  *array = new_array;
+  *capacity = new_capacity;
+  return true;
+}
+
+static bool push_snapshot(history *history) {
+  if (!grow((void **)&history->snapshots, &history->snapshot_capacity,
+            history->snapshot_count, sizeof(history_snapshot)))
+    return false;
+
+  history_snapshot *snapshot = &history->snapshots[history->snapshot_count++];
+  snapshot->ply = history->length;
+  memcpy(snapshot->board, history->board, sizeof(snapshot->board));
+  snapshot->turn = history->turn;
+  snapshot->status = history->status;
+  return true;
+}
+
+static void load_snapshot(history *history, size_t index) {
+  history_snapshot *snapshot = &history->snapshots[index];
+  history->cursor = snapshot->ply;
+  memcpy(history->board, snapshot->board, sizeof(history->board));
+  history->turn = snapshot->turn;
+  history->status = snapshot->status;
+}
+
+// Both of these expect the entry to be next to the cursor.
+static void redo(history *history) {
+  history_entry *entry = &history->entries[history->cursor++];
+
+  if (entry->change_count > HISTORY_MAX_CHANGES) {
+    load_snapshot(history, entry->snapshot);
+    return;
+  }
+
+  for (int i = 0; i < entry->change_count; i++)
+    history->board[entry->changes[i].position] = entry->changes[i].after;
+  history->turn = entry->turn;
+  history->status = entry->status;
+}
+
+static void undo(history *history) {
+  history_entry *entry = &history->entries[--history->cursor];
+
+  if (entry->change_count > HISTORY_MAX_CHANGES) {
+    size_t ply = history->cursor;
+    load_snapshot(history, ply ? history->entries[ply - 1].snapshot : 0);
+    while (history->cursor < ply)
+      redo(history);
+    return;
+  }
+
+  for (int i = 0; i < entry->change_count; i++)
+    history->board[entry->changes[i].position] = entry->changes[i].before;
+
+  if (history->cursor) {
+    history->turn = history->entries[history->cursor - 1].turn;
+    history->status = history->entries[history->cursor - 1].status;
+  } else {
+    history->turn = history->snapshots[0].turn;
+    history->status = history->snapshots[0].status;
+  }
+}
+
+bool history_init(history *history, char *board, bool turn, int status) {
+  memset(history, 0, sizeof(*history));
+  memcpy(history->board, board, sizeof(history->board));
+  history->turn = turn;
+  history->status = status;
+  return push_snapshot(history);
+}
+
+void history_free(history *history) {
+  free(history->entries);
+  free(history->snapshots);
+}
+
+bool history_push(history *history, move move, char *board, bool turn,
+                  int status) {
+  if (!history_at_end(history))
+    history_truncate(history);
+
+  if (!grow((void **)&history->entries, &history->capacity, history->length,
+            sizeof(history_entry)))
+    return false;
+
+  history_entry *entry = &history->entries[history->length];
+  entry->move = move;
+  entry->turn = turn;
+  entry->status = status;
+
+  // Record the squares that changed.
+  entry->change_count = 0;
+  for (int position = 0; position < 64; position++) {
+    if (history->board[position] == board[position])
+      continue;
+
+    if (entry->change_count < HISTORY_MAX_CHANGES)
+      entry->changes[entry->change_count] =
+          (square_change){position, history->board[position], board[position]};
+    entry->change_count++;
+  }
+
+  memcpy(history->board, board, sizeof(history->board));
+  history->turn = turn;
+  history->status = status;
+  history->cursor = ++history->length;
+
+  // Snapshot periodically, or if the move can not be stored as a delta.
+  if (history->length % HISTORY_SNAPSHOT_INTERVAL == 0 ||
+      entry->change_count > HISTORY_MAX_CHANGES) {
+    if (!push_snapshot(history))
+      return false;
+  }
+  entry->snapshot = history->snapshot_count - 1;
+
+  return true;
+}
+
+void history_truncate(history *history) {
+  history->length = history->cursor;
+
+  while (history->snapshots[history->snapshot_count - 1].ply > history->length)
+    history->snapshot_count--;
+}
+
+void history_go(history *history, size_t ply) {
+  if (ply > history->length)
+    ply = history->length;
+
+  // Stepping back a single move is the most common navigation.
+  if (ply + 1 == history->cursor) {
+    undo(history);
+    return;
+  }
+
+  // Start from the nearest snapshot, unless the cursor is closer to the
+  // target.
+  size_t snapshot = ply ? history->entries[ply - 1].snapshot : 0;
+  if (ply < history->cursor ||
+      history->snapshots[snapshot].ply > history->cursor)
+    load_snapshot(history, snapshot);
+
+  while (history->cursor < ply)
+    redo(history);
+}
+
+move history_last_move(history *history) {
+  if (!history->cursor)
+    return (move){.from = POSITION_INV};
+
+  return history->entries[history->cursor - 1].move;
+}
@@ -0,0 +1,108 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "jis_process.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A full board is stored every HISTORY_SNAPSHOT_INTERVAL plies, so any
+// position can be rebuilt by applying at most that many deltas.
+#define HISTORY_SNAPSHOT_INTERVAL 16
+
+// A move changes its from, to and capture squares. Moves changing more squares
+// than this are stored as snapshots.
+#define HISTORY_MAX_CHANGES 4
+
+typedef struct {
+  uint8_t position;
+  char before;
+  char after;
+} square_change;
+
+typedef struct {
+  move move;
+
+  // The state after the move.
+  bool turn;
+  int status;
+
+  uint8_t change_count;
+  square_change changes[HISTORY_MAX_CHANGES];
+
+  // Index of the latest snapshot at or before the position after this move.
+  size_t snapshot;
+} history_entry;
+
+typedef struct {
+  size_t ply;
+  char board[64];
+  bool turn;
+  int status;
+} history_snapshot;
+
+typedef struct {
+  history_entry *entries;
+  size_t length;
+  size_t capacity;
+
+  // The first snapshot is always the starting position.
+  history_snapshot *snapshots;
+  size_t snapshot_count;
+  size_t snapshot_capacity;
+
+  // The viewed position, after the first cursor plies.
+  size_t cursor;
+  char board[64];
+  bool turn;
+  int status;
+} history;
+
+// Start a new history from a position.
+bool history_init(history *history, char *board, bool turn, int status);
+
+void history_free(history *history);
+
+// Append a move and the position it resulted in. Moves after the cursor are
+// dropped first.
+bool history_push(history *history, move move, char *board, bool turn,
+                  int status);
+
+// Drop all moves after the cursor.
+void history_truncate(history *history);
+
+// Move the cursor to the position after ply moves.
+void history_go(history *history, size_t ply);
+
+static inline bool history_at_end(history *history) {
+  return history->cursor == history->length;
+}
+
+// The side to move at the end of the game, whichever position is viewed.
+static inline bool history_end_turn(history *history) {
+  return history->length ? history->entries[history->length - 1].turn
+                         : history->snapshots[0].turn;
+}
+
+// Return the last move of the viewed position, or a move with an invalid
+// from position.
+move history_last_move(history *history);
+
+#endif
@@ -17,18 +17,37 @@ jis-gui. If not, see <https://www.gnu.org/licenses/>.
 #include "jis_process.h"
 #include "fen.h"
 #include "position.h"
+#include "stats.h"
+#include "timing.h"
+#include "transcript.h"
 
 #include <assert.h>
+#include <ctype.h>
+#include <limits.h>
 #include <poll.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
+static atomic_int process_count;
+static bool pass_index;
+
+void jis_pass_index(bool pass) { pass_index = pass; }
+
 bool jis_create_proc(jis_process *process) {
+  process->index = atomic_fetch_add(&process_count, 1);
+
+  // The child only calls functions that are safe after forking a process with
+  // threads, so the argument is formatted before.
+  char index[16];
+  snprintf(index, sizeof(index), "%d", process->index);
+
   // Index 0 will be used for reading, and 1 will be used for writing.
   int child_stdin_pipe[2];
   int child_stdout_pipe[2];
@@ -52,19 +71,25 @@ bool jis_create_proc(jis_process *process) {
     close(child_stdin_pipe[1]);
     close(child_stdout_pipe[0]);
 
+    // The child leaves with _exit, so that it does not run the exit handlers
+    // of the GUI, such as stopping the statistics server.
     if (dup2(child_stdin_pipe[0], fileno(stdin)) < 0 ||
         dup2(child_stdout_pipe[1], fileno(stdout)) < 0) {
       fprintf(stderr, "error: dup2 on child failed\n");
       perror("dup2");
-      exit(1);
+      _exit(1);
     }
 
     // Execute the jazzinsea executable
-    execlp(process->child_executable, process->child_executable, "-d%",
-           (char *)NULL);
+    if (pass_index)
+      execlp(process->child_executable, process->child_executable, "-d%",
+             "-i", index, (char *)NULL);
+    else
+      execlp(process->child_executable, process->child_executable, "-d%",
+             (char *)NULL);
     fprintf(stderr, "error: execl failed\n");
     perror("execl");
-    exit(1);
+    _exit(1);
   }
 
   // The parent process, close unused ends of pipe.
@@ -74,11 +99,30 @@ bool jis_create_proc(jis_process *process) {
   process->child_pid = pid;
   process->child_stdin = child_stdin_pipe[1];
   process->child_stdout = child_stdout_pipe[0];
+  process->pending_replies = 0;
 
+  stats_count_spawn(pid);
   return true;
 }
 
-void jis_kill_proc(jis_process *process) { kill(process->child_pid, SIGKILL); }
+void jis_kill_proc(jis_process *process) {
+  kill(process->child_pid, SIGKILL);
+
+  stats_count_kill();
+  stats_add_pending(-process->pending_replies);
+  process->pending_replies = 0;
+}
+
+bool jis_restart_proc(jis_process *process) {
+  jis_kill_proc(process);
+
+  // Reap the killed process, it does not outlive the GUI as the others do.
+  close(process->child_stdin);
+  close(process->child_stdout);
+  waitpid(process->child_pid, NULL, 0);
+
+  return jis_create_proc(process);
+}
 
 int jis_read(jis_process *process, char *buffer, size_t buffer_size) {
   int length = read(process->child_stdout, buffer, buffer_size - 1);
@@ -88,17 +132,157 @@ int jis_read(jis_process *process, char *buffer, size_t buffer_size) {
     perror("read");
     return length;
   }
+  if (length == 0) {
+    fprintf(stderr, "error: %s exited\n", process->child_executable);
+    return -1;
+  }
   buffer[length - 1] = '\0';
+
+  stats_count_reply(length);
+  transcript_log_reply(process->index, buffer);
+  if (process->pending_replies > 0) {
+    process->pending_replies--;
+    stats_add_pending(-1);
+  }
   return length;
 }
 
+static bool send_command(jis_process *process, bool reply, const char *format,
+                         va_list args) {
+  char command[512];
+  int length = vsnprintf(command, sizeof(command), format, args);
+
+  if (length < 0 || length >= (int)sizeof(command) ||
+      write(process->child_stdin, command, length) != length) {
+    fprintf(stderr, "error: writing to %s failed\n",
+            process->child_executable);
+    perror("write");
+    return false;
+  }
+
+  stats_count_command(command, length);
+  transcript_log_command(process->index, command);
+  if (reply) {
+    process->pending_replies++;
+    stats_add_pending(1);
+  }
+  return true;
+}
+
+bool jis_send(jis_process *process, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  bool success = send_command(process, false, format, args);
+  va_end(args);
+  return success;
+}
+
 int jis_ask(jis_process *process, char *buffer, size_t buffer_size,
             const char *format, ...) {
   va_list args;
   va_start(args, format);
+  bool sent = send_command(process, true, format, args);
+  va_end(args);
+  if (!sent)
+    return -1;
+
+  uint64_t start_ns = timing_now_ns();
+  int length = jis_read(process, buffer, buffer_size);
+  stats_record_round_trip(timing_now_ns() - start_ns);
+  return length;
+}
 
-  vdprintf(process->child_stdin, format, args);
-  return jis_read(process, buffer, buffer_size);
+bool jis_batch_add(jis_process *process, jis_batch *batch, bool reply,
+                   const char *format, ...) {
+  char *command = batch->commands + batch->length;
+  size_t space = sizeof(batch->commands) - batch->length;
+
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(command, space, format, args);
+  va_end(args);
+
+  if (length < 0 || (size_t)length >= space)
+    return false;
+  batch->length += length;
+
+  stats_count_command(command, length);
+  transcript_log_command(process->index, command);
+  if (reply) {
+    batch->reply_count++;
+    process->pending_replies++;
+    stats_add_pending(1);
+  }
+  return true;
+}
+
+static bool batch_failed(jis_process *process, jis_batch *batch,
+                         const char *function) {
+  fprintf(stderr, "error: a batch of commands to %s failed\n",
+          process->child_executable);
+  perror(function);
+  batch->length = 0;
+  batch->reply_count = 0;
+  return false;
+}
+
+bool jis_batch_run(jis_process *process, jis_batch *batch, char *buffer,
+                   size_t buffer_size) {
+  uint64_t start_ns = timing_now_ns();
+  size_t written = 0, received = 0, line_start = 0;
+  int line_count = 0;
+
+  // The replies are read while the commands are written, as the process
+  // stops reading commands once the pipe of its replies is full.
+  while (written < batch->length || line_count < batch->reply_count) {
+    struct pollfd pollfds[2] = {
+        {written < batch->length ? process->child_stdin : -1, POLLOUT},
+        {process->child_stdout, POLLIN},
+    };
+    if (poll(pollfds, 2, -1) < 0)
+      return batch_failed(process, batch, "poll");
+
+    // Writes of up to PIPE_BUF bytes do not block once the pipe is writable.
+    if (pollfds[0].revents) {
+      size_t length = batch->length - written;
+      if (length > PIPE_BUF)
+        length = PIPE_BUF;
+      ssize_t result =
+          write(process->child_stdin, batch->commands + written, length);
+      if (result < 0)
+        return batch_failed(process, batch, "write");
+      written += result;
+    }
+
+    if (pollfds[1].revents) {
+      if (received + 1 >= buffer_size)
+        return batch_failed(process, batch, "read");
+      ssize_t result = read(process->child_stdout, buffer + received,
+                            buffer_size - received - 1);
+      if (result <= 0)
+        return batch_failed(process, batch, "read");
+      stats_count_reply(result);
+
+      for (size_t end = received + result; received < end; received++) {
+        if (buffer[received] != '\n')
+          continue;
+        buffer[received] = '\0';
+        transcript_log_reply(process->index, buffer + line_start);
+        line_start = received + 1;
+        line_count++;
+
+        if (process->pending_replies > 0) {
+          process->pending_replies--;
+          stats_add_pending(-1);
+        }
+      }
+    }
+  }
+
+  stats_record_round_trip(timing_now_ns() - start_ns);
+  batch->length = 0;
+  batch->reply_count = 0;
+  return true;
 }
 
 move jis_desc_move(jis_process *process, char *string) {
@@ -106,7 +290,9 @@ move jis_desc_move(jis_process *process, char *string) {
   // This will fill the buffer with 'from', 'to' and 'capture'
   // position strings seperated by spaces.
   char first_word[256];
-  jis_ask(process, first_word, sizeof(first_word), "descmove %s\n", string);
+  if (jis_ask(process, first_word, sizeof(first_word), "descmove %s\n",
+              string) < 0)
+    return (move){.from = POSITION_INV};
 
   // Convert into a list of strings separated by \0.
   char *second_word = strchr(first_word, ' ');
@@ -150,12 +336,28 @@ bool jis_copy_position(jis_process *process, char *board, bool *board_turn,
 
 bool jis_make_move(jis_process *process, char *board, bool *board_turn,
                    int *board_status, char *move_string) {
-  dprintf(process->child_stdin, "makemove %s\n", move_string);
+  if (!jis_send(process, "makemove %s\n", move_string))
+    return false;
   return jis_copy_position(process, board, board_turn, board_status);
 }
 
+bool jis_load_position(jis_process *process, char *board, bool board_turn) {
+  char fen[128];
+  get_fen_string(fen, board, board_turn);
+
+  return jis_send(process, "loadfen %s\n", fen);
+}
+
+// The reply is read later, through jis_read.
+static void start_eval(jis_process *process, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  send_command(process, true, format, args);
+  va_end(args);
+}
+
 void jis_start_eval_r(jis_process *process) {
-  dprintf(process->child_stdin, "evaluate -r\n");
+  start_eval(process, "evaluate -r\n");
 }
 
 int jis_poll(jis_process *process) {
@@ -175,7 +377,9 @@ bool jis_ask_avail_moves(jis_process *process, int from_position,
   get_position_str(from_position, position_str);
 
   char buffer[256];
-  jis_ask(process, buffer, sizeof(buffer), "allmoves %s\n", position_str);
+  if (jis_ask(process, buffer, sizeof(buffer), "allmoves %s\n",
+              position_str) < 0)
+    return false;
 
   // Add available moves.
   int i = 0;
@@ -195,6 +399,8 @@ bool jis_ask_avail_moves(jis_process *process, int from_position,
     // Ask jazzinsea to describe the move.
     // Every move must originate from the from_position.
     move result = jis_desc_move(process, current_move_string);
+    if (!is_valid(result.from))
+      return false;
     assert(result.from == from_position);
     available_moves[i++] = result;
 
@@ -203,3 +409,33 @@ bool jis_ask_avail_moves(jis_process *process, int from_position,
 
   return true;
 }
+
+int jis_ask_all_moves(jis_process *process, char *board, bool board_turn,
+                      move *moves, size_t max_moves) {
+  size_t move_count = 0;
+
+  for (int position = 0; position < 64; position++) {
+    // White pieces are uppercase.
+    if (board[position] == ' ' || !isupper(board[position]) != !board_turn)
+      continue;
+
+    move piece_moves[4] = {
+        {POSITION_INV},
+        {POSITION_INV},
+        {POSITION_INV},
+        {POSITION_INV},
+    };
+    if (!jis_ask_avail_moves(process, position, piece_moves))
+      return -1;
+
+    for (int i = 0; i < 4 && is_valid(piece_moves[i].from); i++) {
+      if (move_count == max_moves) {
+        fprintf(stderr, "error: too many moves\n");
+        return -1;
+      }
+      moves[move_count++] = piece_moves[i];
+    }
+  }
+
+  return move_count;
+}
@@ -25,6 +25,13 @@ typedef struct {
   const char *child_executable;
   int child_stdin;
   int child_stdout;
+
+  // Replies asked for but not read yet.
+  int pending_replies;
+
+  // The order in which the process was created, also given to it as "-i
+  // index" if jis_pass_index was set.
+  int index;
 } jis_process;
 
 typedef struct {
@@ -37,16 +44,48 @@ typedef struct {
 // Create a subprocess by executing the process.child_executable.
 bool jis_create_proc(jis_process *process);
 
+// Give the processes created afterwards their index as "-i index" after their
+// other arguments. Only the stand-in engine takes it, to find its replies in a
+// replayed session.
+void jis_pass_index(bool pass);
+
 // Kill the process.
 void jis_kill_proc(jis_process *process);
 
+// Kill the process and create a new one in its place, which starts from the
+// initial position. Replies still on the way are lost.
+bool jis_restart_proc(jis_process *process);
+
 // Block and read from the process stdout until some data is available.
 int jis_read(jis_process *process, char *buffer, size_t buffer_size);
 
+// Send a formatted command that has no reply to process stdin.
+bool jis_send(jis_process *process, const char *format, ...);
+
 // Send formatted commands to process stdin and collect the stdout of process.
 int jis_ask(jis_process *process, char *buffer, size_t buffer_size,
             const char *format, ...);
 
+// Commands collected to be written to a process at once, so that all of their
+// replies cost a single round trip.
+#define JIS_BATCH_SIZE 65536
+
+typedef struct {
+  char commands[JIS_BATCH_SIZE];
+  size_t length;
+  int reply_count;
+} jis_batch;
+
+// Add a formatted command to the batch, which has a reply of one line if reply
+// is set. Returns false if the batch is full.
+bool jis_batch_add(jis_process *process, jis_batch *batch, bool reply,
+                   const char *format, ...);
+
+// Write the commands of the batch and read their replies into the buffer, one
+// after the other and each terminated by '\0'. The batch is emptied.
+bool jis_batch_run(jis_process *process, jis_batch *batch, char *buffer,
+                   size_t buffer_size);
+
 // Ask process to describe move and return.
 move jis_desc_move(jis_process *process, char *string);
 
@@ -58,6 +97,9 @@ bool jis_copy_position(jis_process *process, char *board, bool *board_turn,
 bool jis_make_move(jis_process *process, char *board, bool *board_turn,
                    int *board_status, char *move_string);
 
+// Load a board position into the process.
+bool jis_load_position(jis_process *process, char *board, bool board_turn);
+
 // Start a random evaluation on the process.
 void jis_start_eval_r(jis_process *process);
 
@@ -68,4 +110,9 @@ int jis_poll(jis_process *process);
 bool jis_ask_avail_moves(jis_process *process, int from_position,
                          move available_moves[4]);
 
+// Ask the process all moves of the side to move, returning the number of moves
+// or -1 on failure.
+int jis_ask_all_moves(jis_process *process, char *board, bool board_turn,
+                      move *moves, size_t max_moves);
+
 #endif
@@ -14,16 +14,35 @@ You should have received a copy of the GNU General Public License along with
 jis-gui. If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include "analysis.h"
+#include "bench.h"
+#include "book.h"
+#include "broadcast.h"
+#include "diagram.h"
 #include "fen.h"
 #include "gui.h"
+#include "hash.h"
+#include "history.h"
 #include "jis_process.h"
+#include "movecache.h"
+#include "perft.h"
+#include "ponder.h"
 #include "position.h"
+#include "record.h"
+#include "replay.h"
+#include "search.h"
+#include "session.h"
+#include "spectate.h"
+#include "stats.h"
+#include "tablebase.h"
+#include "timing.h"
 
 #include <raylib.h>
 
 #include <assert.h>
 #include <libgen.h>
 #include <poll.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -32,23 +51,319 @@ jis-gui. If not, see <https://www.gnu.org/licenses/>.
 #include <stdlib.h>
 #include <string.h>
 #include <sys/poll.h>
+#include <time.h>
 #include <unistd.h>
 
 const char *JIS_EXECUTABLE = "jazzinsea";
 
+void print_usage(const char *program) {
+  fprintf(stderr,
+          "usage: %s [-p] [-t seconds] [-i seconds] [-m milliseconds]\n"
+          "       [-r archive] [-g archive -n index | -s session] [-b book]\n"
+          "       [-B book -g archive] [-a engines] [-D directory]\n"
+          "       [-T signature [-j threads]] [-d depth [-j threads]]\n"
+          "       [-e executable] [-X plies] [-F fens]\n"
+          "       [-I fens [-o directory] [-j threads]]\n"
+          "       [-S socket] [-R file | -P file]\n"
+          "       [-W socket | -w socket]\n"
+          "  -p  think on the time of the user\n"
+          "  -t  time of each player, untimed by default\n"
+          "  -i  increment after every move\n"
+          "  -m  upper bound of a single move\n"
+          "  -r  append the played games to an archive\n"
+          "  -g  load a game from an archive\n"
+          "  -n  index of the game to load, starting from 0\n"
+          "  -b  play the opening moves from a book\n"
+          "  -B  build a book from the games of an archive\n"
+          "  -a  number of engines used for analysis\n"
+          "  -D  directory of the endgame tables\n"
+          "  -T  generate the endgame table of the pieces, such as PNp\n"
+          "  -j  number of threads used to generate tables, count moves or\n"
+          "      encode diagrams\n"
+          "  -e  engine executable, jazzinsea by default\n"
+          "  -X  play a number of plies without a window and time them\n"
+          "  -d  count the positions up to a depth through the engine\n"
+          "  -F  check and time the FEN parsers on a file of FEN lines\n"
+          "  -I  draw a PNG diagram of every line of a file of FEN lines\n"
+          "  -o  directory of the diagrams, the current one by default\n"
+          "  -s  resume the session from a file and save it there on exit\n"
+          "  -S  serve statistics on a Unix socket\n"
+          "  -R  record the input and the engine replies to a file\n"
+          "  -P  replay a recorded file against the stand-in engine\n"
+          "  -W  broadcast the game to spectators on a Unix socket\n"
+          "  -w  watch the game broadcast on a Unix socket\n",
+          program);
+}
+
+// Tell the engine the position at the end of the game, whichever position is
+// being viewed.
+static bool load_game_end(jis_process *process, history *history) {
+  size_t cursor = history->cursor;
+  history_go(history, history->length);
+  bool success = jis_load_position(process, history->board, history->turn);
+  history_go(history, cursor);
+  return success;
+}
+
+typedef enum { GUI, AI } player;
+
+// The game saved with -s. It is saved by an exit handler, so that the session
+// is kept whichever way main returns. The handler runs after main returned, so
+// the state it points to is static.
+static struct {
+  const char *path;
+  history *history;
+  const move_cache *cache;
+  game_clock *clock;
+  const player *players;
+  const int *interrupted_turn;
+  const bool *analysing;
+  const bool *lost_on_time;
+} saved_game;
+
+static void save_game() {
+  if (!saved_game.path)
+    return;
+
+  // The running turn is the one at the end of the game, not the viewed one.
+  bool end_turn = history_end_turn(saved_game.history);
+  const player *players = saved_game.players;
+  int interrupted_turn = *saved_game.interrupted_turn;
+  session_settings session = {
+      .engine_plays = {players[0] == AI || interrupted_turn == 0,
+                       players[1] == AI || interrupted_turn == 1},
+      .analysing = *saved_game.analysing,
+      .lost_on_time = *saved_game.lost_on_time,
+      .remaining_ms = {game_clock_remaining(saved_game.clock, 0, end_turn),
+                       game_clock_remaining(saved_game.clock, 1, end_turn)},
+  };
+  session_save(saved_game.path, saved_game.history, saved_game.cache,
+               &session);
+
+  // Only save once, the handler may run after main saved.
+  saved_game.path = NULL;
+}
+
 int main(int argc, char *argv[]) {
+  long base_ms = -1;
+  long increment_ms = 0;
+  long movetime_ms = 0;
+  bool pondering = false;
+  const char *record_path = NULL;
+  const char *archive_path = NULL;
+  size_t game_index = 0;
+  const char *book_path = NULL;
+  const char *build_book_path = NULL;
+  long analysis_engines = sysconf(_SC_NPROCESSORS_ONLN);
+  const char *tablebase_directory = NULL;
+  const char *generate_signature = NULL;
+  long generate_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  const char *executable = JIS_EXECUTABLE;
+  long bench_plies = 0;
+  long perft_depth = 0;
+  const char *bench_fens_path = NULL;
+  const char *diagram_path = NULL;
+  const char *diagram_directory = ".";
+  const char *session_path = NULL;
+  const char *stats_path = NULL;
+  const char *record_input_path = NULL;
+  const char *replay_path = NULL;
+  const char *broadcast_path = NULL;
+  const char *watch_path = NULL;
+
+  int option;
+  while ((option = getopt(argc, argv,
+                          "pt:i:m:r:g:n:b:B:a:D:T:j:e:X:d:F:I:o:"
+                          "s:S:R:P:W:w:")) != -1) {
+    switch (option) {
+    case 'p':
+      pondering = true;
+      break;
+    case 't':
+      base_ms = strtod(optarg, NULL) * 1000;
+      break;
+    case 'i':
+      increment_ms = strtod(optarg, NULL) * 1000;
+      break;
+    case 'm':
+      movetime_ms = strtol(optarg, NULL, 10);
+      break;
+    case 'r':
+      record_path = optarg;
+      break;
+    case 'g':
+      archive_path = optarg;
+      break;
+    case 'n':
+      game_index = strtoul(optarg, NULL, 10);
+      break;
+    case 'b':
+      book_path = optarg;
+      break;
+    case 'B':
+      build_book_path = optarg;
+      break;
+    case 'a':
+      analysis_engines = strtol(optarg, NULL, 10);
+      break;
+    case 'D':
+      tablebase_directory = optarg;
+      break;
+    case 'T':
+      generate_signature = optarg;
+      break;
+    case 'j':
+      generate_threads = strtol(optarg, NULL, 10);
+      break;
+    case 'e':
+      executable = optarg;
+      break;
+    case 'X':
+      bench_plies = strtol(optarg, NULL, 10);
+      break;
+    case 'F':
+      bench_fens_path = optarg;
+      break;
+    case 'I':
+      diagram_path = optarg;
+      break;
+    case 'o':
+      diagram_directory = optarg;
+      break;
+    case 'd':
+      perft_depth = strtol(optarg, NULL, 10);
+      break;
+    case 's':
+      session_path = optarg;
+      break;
+    case 'S':
+      stats_path = optarg;
+      break;
+    case 'R':
+      record_input_path = optarg;
+      break;
+    case 'P':
+      replay_path = optarg;
+      break;
+    case 'W':
+      broadcast_path = optarg;
+      break;
+    case 'w':
+      watch_path = optarg;
+      break;
+    default:
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  // A loaded game would replace the saved session on exit.
+  if ((record_input_path && replay_path) || (broadcast_path && watch_path) ||
+      (session_path && archive_path && !build_book_path)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  // Recorded sessions must choose the same book moves when replayed.
+  srand(record_input_path || replay_path ? 1 : time(NULL));
+
+  // Recording must start before the first engine is spawned, and the stand-in
+  // engines find the replies to replay in the same file.
+  replay replay = {.mode = REPLAY_OFF};
+  if (record_input_path && !replay_record(&replay, record_input_path))
+    return 1;
+  if (replay_path) {
+    if (!replay_open(&replay, replay_path))
+      return 1;
+    setenv("JIS_STANDIN_TRANSCRIPT", replay_path, 1);
+    jis_pass_index(true);
+  }
+
+  // Checking the FEN parsers does not talk to any engine.
+  if (bench_fens_path)
+    return bench_fens(bench_fens_path) ? 0 : 1;
+
+  // The server is stopped on exit, whichever way main returns.
+  if (stats_path && !stats_server_start(stats_path))
+    return 1;
+
+  if (bench_plies > 0)
+    return bench_run(executable, bench_plies) ? 0 : 1;
+
+  if (perft_depth > 0)
+    return perft_run(executable, perft_depth, generate_threads) ? 0 : 1;
+
+  // Building a book does not need a window.
+  if (build_book_path) {
+    if (!archive_path) {
+      print_usage(argv[0]);
+      return 1;
+    }
+
+    jis_process process = {.child_executable = executable};
+    if (!jis_create_proc(&process)) {
+      return 1;
+    }
+
+    bool success = book_build(archive_path, build_book_path, &process);
+    jis_kill_proc(&process);
+    return success ? 0 : 1;
+  }
+
+  // Neither does generating tables.
+  if (generate_signature) {
+    bool success = tablebase_generate(
+        tablebase_directory ? tablebase_directory : ".", generate_signature,
+        executable, generate_threads);
+    return success ? 0 : 1;
+  }
+
+  tablebase endgame_tables;
+  tablebase_init(&endgame_tables, tablebase_directory);
+
+  book opening_book = {0};
+  if (book_path && !book_open(&opening_book, book_path)) {
+    return 1;
+  }
+
+  // Diagrams are drawn offscreen, the window only provides the context.
+  if (diagram_path)
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+
   gui_init();
 
   // Load the assets.
   assets gui_assets;
   gui_load_assets(&gui_assets);
 
+  if (diagram_path) {
+    bool success = diagram_render(diagram_path, diagram_directory,
+                                  &gui_assets, generate_threads);
+    gui_unload_assets(&gui_assets);
+    CloseWindow();
+    return success ? 0 : 1;
+  }
+
+  // Spectators only draw what they are sent.
+  if (watch_path) {
+    bool success = spectate(watch_path, &gui_assets);
+    gui_unload_assets(&gui_assets);
+    CloseWindow();
+    return success ? 0 : 1;
+  }
+
   // Try to create a JazzInSea process.
-  jis_process process = {.child_executable = JIS_EXECUTABLE};
+  jis_process process = {.child_executable = executable};
   if (!jis_create_proc(&process)) {
     return 1;
   }
 
+  // The pondering process is only spawned if requested.
+  ponder ponder = {.search = {.state = SEARCH_IDLE}};
+  if (pondering && !ponder_init(&ponder, executable)) {
+    return 1;
+  }
+
   // Copy the board position from the process.
   char board[64];
   bool board_turn;
@@ -65,51 +380,348 @@ int main(int argc, char *argv[]) {
   };
   move last_move = {POSITION_INV};
 
-  enum { GUI, AI } players[2] = {AI, GUI};
-  bool asked_for_move = false;
+  // The state saved with -s is static.
+  static player players[2] = {AI, GUI};
+
+  // The side of the engine whose move the user plays instead, or -1.
+  static int interrupted_turn = -1;
+
+  static history history;
+  static move_cache cache;
+  session_settings session = {0};
+  bool restored = false;
+  game_writer writer;
+  game_writer *active_writer = NULL;
+
+  if (archive_path) {
+    // Replay a recorded game through the engine to fill the history.
+    game_archive archive;
+    game_record record;
+    if (!game_archive_open(&archive, archive_path)) {
+      return 1;
+    }
+    if (!game_archive_get(&archive, game_index, &record) ||
+        !load_fen(record.fen, board, &board_turn) ||
+        !jis_load_position(&process, board, board_turn) ||
+        !jis_copy_position(&process, board, &board_turn, &board_status) ||
+        !history_init(&history, board, board_turn, board_status)) {
+      fprintf(stderr, "error: could not load game %zu\n", game_index);
+      return 1;
+    }
+
+    size_t offset = 0;
+    move recorded_move;
+    while (game_record_next_move(&record, &offset, &recorded_move)) {
+      if (!gui_make_move(&process, &gui_assets, board, &board_turn,
+                         &board_status, recorded_move.string, &last_move,
+                         &history, NULL)) {
+        fprintf(stderr, "error: could not load game %zu\n", game_index);
+        return 1;
+      }
+    }
+    game_archive_close(&archive);
+
+    // Loaded games are for analysis, do not let the engine continue them.
+    players[0] = players[1] = GUI;
 
-  uint anim_counter = MOVE_ANIM_FRAMES;
+  } else if (session_path &&
+             !session_load(session_path, &history, &cache, &session,
+                           &restored)) {
+    return 1;
 
-  while (!WindowShouldClose()) {
-    Vector2 mouse_vec = GetMousePosition();
+  } else if (restored) {
+    // The engine continues from the end of the game.
+    if (!load_game_end(&process, &history))
+      return 1;
 
-    if (players[board_turn] == AI) {
-      if (!asked_for_move) {
-        // Ask the AI for a move.
-        jis_start_eval_r(&process);
-        asked_for_move = true;
+    memcpy(board, history.board, sizeof(board));
+    board_turn = history.turn;
+    board_status = history.status;
+    last_move = history_last_move(&history);
 
-      } else {
-        // Check if AI returned a move.
-        int result = jis_poll(&process);
+    players[0] = session.engine_plays[0] ? AI : GUI;
+    players[1] = session.engine_plays[1] ? AI : GUI;
 
-        if (result < 0)
-          return 1;
+  } else if (!history_init(&history, board, board_turn, board_status)) {
+    return 1;
+  }
+
+  jis_search search = {.process = &process, .state = SEARCH_IDLE};
+
+  static game_clock clock;
+  game_clock_init(&clock, base_ms, increment_ms, movetime_ms);
+  static bool lost_on_time = false;
 
-        if (result > 0) {
-          asked_for_move = false;
+  // The analysis engines are spawned the first time they are needed.
+  analysis analysis = {0};
+  static bool analysing = false;
+
+  if (restored) {
+    for (int turn = 0; turn < 2; turn++) {
+      if (clock.remaining_ms[turn] >= 0 && session.remaining_ms[turn] >= 0)
+        clock.remaining_ms[turn] = session.remaining_ms[turn];
+    }
+    if (!history_at_end(&history))
+      game_clock_pause(&clock);
 
-          // Child returned, make the generated move.
-          char move_string[8];
-          if (jis_read(&process, move_string, sizeof(move_string)) < 0) {
+    lost_on_time = session.lost_on_time;
+    if (history_at_end(&history) && lost_on_time)
+      board_status = (board_turn ? 3 : 2) << 4;
+
+    if (session.analysing && analysis_engines > 0) {
+      if (!analysis_init(&analysis, executable, analysis_engines))
+        return 1;
+      analysing = true;
+    }
+  }
+
+  // From now on the session is saved on exit, even after an error.
+  if (session_path) {
+    saved_game.path = session_path;
+    saved_game.history = &history;
+    saved_game.cache = &cache;
+    saved_game.clock = &clock;
+    saved_game.players = players;
+    saved_game.interrupted_turn = &interrupted_turn;
+    saved_game.analysing = &analysing;
+    saved_game.lost_on_time = &lost_on_time;
+    atexit(save_game);
+
+    // An engine that died fails the next write instead of killing the GUI
+    // with SIGPIPE, which would not run the handler.
+    signal(SIGPIPE, SIG_IGN);
+  }
+
+  if (record_path) {
+    if (!game_writer_open(&writer, record_path) ||
+        !game_writer_begin_history(&writer, &history)) {
+      return 1;
+    }
+    active_writer = &writer;
+  }
+
+  broadcaster spectators = {.fd = -1};
+  if (broadcast_path && !broadcast_start(&spectators, broadcast_path))
+    return 1;
+
+  // When the last move started to be animated, 0 if it is not.
+  uint64_t anim_start_ms = 0;
+  int frame_rate = 0;
+
+  gui_input input = {0};
+  latency_samples latency = {0};
+  bool show_latency = false;
+  uint64_t frame_end_ns = timing_now_ns();
+
+  size_t frame = 0;
+  for (; !WindowShouldClose() && !replay_finished(&replay, frame); frame++) {
+    // The side to move loses if it runs out of time on the clock. An engine
+    // whose search runs past the move time is waited for, as the protocol can
+    // not ask it for its best move so far.
+    bool out_of_time = history_at_end(&history) && board_status >> 4 == 0 &&
+                       game_clock_flagged(&clock, board_turn);
+
+    if (pondering && !ponder_update(&ponder))
+      return 1;
+
+    // The game is paused while looking at the past.
+    if (!out_of_time && players[board_turn] == AI && board_status >> 4 == 0 &&
+        history_at_end(&history) && replay_engine_due(&replay, frame)) {
+      char move_string[8];
+      jis_search_result result = SEARCH_PENDING;
+
+      // A replay makes the move in the frame it was made in when recorded, so
+      // it waits for the engine instead of polling it.
+      bool wait = replay.mode == REPLAY_PLAYING;
+      do {
+        if (ponder.hit) {
+          if (wait && !ponder_update(&ponder))
             return 1;
-          }
 
-          gui_make_move(&process, &gui_assets, board, &board_turn,
-                        &board_status, move_string, &last_move);
-          anim_counter = 0;
+          // The user played the predicted move, the answer is already on the
+          // way.
+          if (ponder.state == PONDER_READY) {
+            strcpy(move_string, ponder.answer);
+            ponder_stop(&ponder);
+            result = SEARCH_DONE;
+          } else if (ponder.late) {
+            ponder.late = false;
+            result = SEARCH_TIMEOUT;
+          }
 
-          // If there is a selected piece, generated moves for it.
-          if (is_valid(selected_piece)) {
-            jis_ask_avail_moves(&process, selected_piece, available_moves);
+        } else if (search.state == SEARCH_IDLE) {
+          // Known openings and endgames are played without asking the AI.
+          move known_move;
+          if (book_probe(&opening_book, board, board_turn, &known_move) ||
+              tablebase_best_move(&endgame_tables, &process, board, board_turn,
+                                  &known_move)) {
+            strcpy(move_string, known_move.string);
+            result = SEARCH_DONE;
+
+          } else {
+            // Ask the AI for a move.
+            if (!jis_search_start(&search,
+                                  game_clock_budget(&clock, board_turn)))
+              return 1;
           }
+
+        } else if (wait) {
+          result = jis_search_wait(&search, move_string, sizeof(move_string));
+
+        } else if (search.state == SEARCH_RUNNING) {
+          // Check if AI returned a move.
+          result = jis_search_poll(&search, move_string, sizeof(move_string));
         }
+      } while (wait && (result == SEARCH_PENDING || result == SEARCH_NONE));
+
+      if (result == SEARCH_ERROR)
+        return 1;
+      if (result == SEARCH_TIMEOUT && game_clock_flagged(&clock, board_turn))
+        out_of_time = true;
+
+      if (result == SEARCH_DONE) {
+        // Child returned, make the generated move.
+        replay_engine_moved(&replay, frame);
+        game_clock_end_turn(&clock, board_turn);
+        if (!gui_make_move(&process, &gui_assets, board, &board_turn,
+                           &board_status, move_string, &last_move, &history,
+                           active_writer))
+          return 1;
+        anim_start_ms = timing_now_ms();
+
+        // If there is a selected piece, generated moves for it.
+        if (is_valid(selected_piece)) {
+          if (!move_cache_avail_moves(&cache, &process, board, board_turn,
+                                      selected_piece, available_moves))
+            return 1;
+        }
+
+        // Think on the time of the user.
+        if (pondering && players[board_turn] == GUI && board_status >> 4 == 0)
+          ponder_start(&ponder, board, board_turn);
       }
     }
 
-    if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
-      if (CheckCollisionPointRec(mouse_vec, BOARD_RECT)) {
-        int pressed_position = window_vec_to_id(mouse_vec);
+    if (out_of_time) {
+      jis_search_cancel(&search);
+      ponder_stop(&ponder);
+      board_status = (board_turn ? 3 : 2) << 4;
+      lost_on_time = true;
+      if (active_writer)
+        game_writer_set_result(active_writer, board_status);
+    }
+
+    if (analysing && (!analysis.running ||
+                      analysis.hash != board_hash(board, board_turn))) {
+      if (!analysis_start(&analysis, board, board_turn))
+        return 1;
+    }
+
+    if (analysis.engines && !analysis_update(&analysis))
+      return 1;
+
+    // Abandoned searches must be drained before asking anything else.
+    if (search.state == SEARCH_DRAINING &&
+        jis_search_poll(&search, NULL, 0) == SEARCH_ERROR)
+      return 1;
+
+    // Input is polled again only now, after the engine work above, so that the
+    // frame reacts to and draws the freshest state of the mouse.
+    PollInputEvents();
+    if (replay.mode != REPLAY_PLAYING)
+      gui_input_collect(&input);
+    replay_input(&replay, frame, &input);
+
+    // Navigate through the history without asking the engine.
+    size_t target_ply = history.cursor;
+    if (input.keys_pressed[INPUT_KEY_LEFT] && target_ply > 0)
+      target_ply--;
+    if (input.keys_pressed[INPUT_KEY_RIGHT] && target_ply < history.length)
+      target_ply++;
+    if (input.keys_pressed[INPUT_KEY_HOME])
+      target_ply = 0;
+    if (input.keys_pressed[INPUT_KEY_END])
+      target_ply = history.length;
+    if (input.mouse_pressed) {
+      int clicked_ply = gui_history_ply_at(&history, input.mouse);
+      if (clicked_ply >= 0)
+        target_ply = clicked_ply;
+    }
+
+    if (target_ply != history.cursor) {
+      history_go(&history, target_ply);
+
+      // The clock stops while the past is viewed.
+      if (history_at_end(&history))
+        game_clock_resume(&clock);
+      else
+        game_clock_pause(&clock);
+
+      memcpy(board, history.board, sizeof(board));
+      board_turn = history.turn;
+      board_status = history.status;
+      if (history_at_end(&history) && lost_on_time)
+        board_status = (board_turn ? 3 : 2) << 4;
+      last_move = history_last_move(&history);
+
+      selected_piece = POSITION_INV;
+      for (int i = 0; i < 4; i++) {
+        available_moves[i].from = POSITION_INV;
+      }
+      anim_start_ms = 0;
+    }
+
+    // Let the user interrupt the AI and play the move instead. The engine is
+    // restarted rather than drained, so that the board reacts at once.
+    if (input.keys_pressed[INPUT_KEY_SPACE] &&
+        (search.state == SEARCH_RUNNING || ponder.hit)) {
+      if (search.state == SEARCH_RUNNING &&
+          (!jis_search_abort(&search) || !load_game_end(&process, &history)))
+        return 1;
+      ponder_stop(&ponder);
+      players[board_turn] = GUI;
+      interrupted_turn = board_turn;
+    }
+
+    // Toggle the analysis of the shown position.
+    if (input.keys_pressed[INPUT_KEY_ANALYSIS]) {
+      analysing = !analysing;
+
+      if (!analysing) {
+        analysis_stop(&analysis);
+      } else if (!analysis.engines) {
+        if (analysis_engines < 1 ||
+            !analysis_init(&analysis, executable, analysis_engines))
+          return 1;
+      }
+    }
+
+    if (input.keys_pressed[INPUT_KEY_LATENCY])
+      show_latency = !show_latency;
+
+    // The engine can only be asked again once an abandoned search is drained,
+    // until then the board does not react.
+    if (input.mouse_pressed) {
+      if (CheckCollisionPointRec(input.mouse, BOARD_RECT) &&
+          search.state == SEARCH_IDLE) {
+        // Resume the game from the viewed position. This is the only time
+        // the engine needs to be told about the navigation.
+        if (!history_at_end(&history)) {
+          history_truncate(&history);
+          ponder_stop(&ponder);
+          lost_on_time = false;
+          game_clock_start_turn(&clock);
+
+          if (!jis_load_position(&process, board, board_turn))
+            return 1;
+
+          // The abandoned line stays in the archive as a game of its own.
+          if (active_writer &&
+              !game_writer_begin_history(active_writer, &history))
+            return 1;
+        }
+
+        int pressed_position = window_vec_to_id(input.mouse);
 
         move made_move =
             find_move_for_position(available_moves, pressed_position);
@@ -123,51 +735,37 @@ int main(int argc, char *argv[]) {
 
         if (is_valid(made_move.from)) {
           // Make move on board and tell jazzinsea to update its board as well.
-          gui_make_move(&process, &gui_assets, board, &board_turn,
-                        &board_status, made_move.string, &last_move);
-          anim_counter = 0;
+          game_clock_end_turn(&clock, board_turn);
+          ponder_user_moved(&ponder, made_move.string,
+                            game_clock_budget(&clock, !board_turn));
+          if (!gui_make_move(&process, &gui_assets, board, &board_turn,
+                             &board_status, made_move.string, &last_move,
+                             &history, active_writer))
+            return 1;
+          anim_start_ms = timing_now_ms();
           selected_piece = POSITION_INV;
 
+          // The engine plays again after the move it was interrupted on.
+          if (interrupted_turn >= 0) {
+            players[interrupted_turn] = AI;
+            interrupted_turn = -1;
+          }
+
         } else if (players[board_turn] == GUI &&
                    board[pressed_position] != ' ') {
 
-          char position_str[3];
-          get_position_str(selected_piece, position_str);
-
-          char buffer[256];
-          jis_ask(&process, buffer, sizeof(buffer), "allmoves %s\n",
-                  position_str);
-
-          // Add available moves.
-          int i = 0;
-          char *current_move_string = buffer + 2;
-          while (*current_move_string != '}') {
-            char *new = strchr(current_move_string, ' ');
-            if (!new) {
-              fprintf(stderr, "error: invalid moves list from jazzinsea\n");
-              return 1;
-            }
-            *new = '\0';
-
-            // There can not be more than 4 moves.
-            assert(i < 4);
-
-            // Ask jazzinsea to describe the move.
-            // Every move must originate from the held piece.
-            move result = jis_desc_move(&process, current_move_string);
-            assert(result.from == selected_piece);
-            available_moves[i++] = result;
-
-            current_move_string = new + 1;
-          }
+          // Positions seen before are answered without asking jazzinsea.
+          if (!move_cache_avail_moves(&cache, &process, board, board_turn,
+                                      selected_piece, available_moves))
+            return 1;
         }
       }
-    } else if (IsMouseButtonReleased(MOUSE_BUTTON_LEFT)) {
+    } else if (input.mouse_released && search.state == SEARCH_IDLE) {
       if (board[selected_piece] == ' ') {
         selected_piece = POSITION_INV;
 
       } else {
-        int pressed_position = window_vec_to_id(mouse_vec);
+        int pressed_position = window_vec_to_id(input.mouse);
         move made_move =
             find_move_for_position(available_moves, pressed_position);
 
@@ -177,129 +775,119 @@ int main(int argc, char *argv[]) {
             available_moves[i].from = POSITION_INV;
           }
 
-          gui_make_move(&process, &gui_assets, board, &board_turn,
-                        &board_status, made_move.string, &last_move);
-          anim_counter = MOVE_ANIM_FRAMES;
+          game_clock_end_turn(&clock, board_turn);
+          ponder_user_moved(&ponder, made_move.string,
+                            game_clock_budget(&clock, !board_turn));
+          if (!gui_make_move(&process, &gui_assets, board, &board_turn,
+                             &board_status, made_move.string, &last_move,
+                             &history, active_writer))
+            return 1;
+          anim_start_ms = 0;
+
+          if (interrupted_turn >= 0) {
+            players[interrupted_turn] = AI;
+            interrupted_turn = -1;
+          }
         }
       }
     }
 
+    // Spectators see the shown position, sent as a move whenever it is one.
+    broadcast_update(&spectators, board, board_turn, board_status,
+                     lost_on_time, last_move);
+
+    // The animation follows the clock, so stalled frames do not slow it down.
+    float anim_progress = 1;
+    if (anim_start_ms)
+      anim_progress = (float)(timing_now_ms() - anim_start_ms) / MOVE_ANIM_MS;
+
     // Board graphics
     BeginDrawing();
     ClearBackground(BACKGROUND_COLOR);
 
-    DrawTextureRec(gui_assets.grid_texture,
-                   (Rectangle){0, 0, gui_assets.grid_texture.width,
-                               gui_assets.grid_texture.height},
-                   (Vector2){BOARD_RECT.x, BOARD_RECT.y}, WHITE);
+    gui_draw_board(&gui_assets, board, last_move, selected_piece,
+                   available_moves, anim_progress, &input);
+    gui_draw_status(board_status, board_turn, lost_on_time);
 
-    if (is_valid(selected_piece) && selected_piece != last_move.to) {
-      DrawRectangleRec(pos_to_window_rect(selected_piece), GRID_HELD_COLOR);
-    }
+    gui_draw_history(&history);
+    if (analysing)
+      gui_draw_analysis(&analysis);
 
-    if (is_valid(last_move.from)) {
-      DrawRectangleRec(pos_to_window_rect(last_move.from),
-                       LAST_MOVE_FROM_COLOR);
-      DrawRectangleRec(pos_to_window_rect(last_move.to), LAST_MOVE_TO_COLOR);
-    }
-
-    // Rows are inverted, unlike how jazz-in-sea represents them.
-    for (int position = 0; position < 64; position++) {
-      Texture2D *texture;
-      switch (board[position]) {
-      case 'P':
-        texture = &gui_assets.white_pawn_texture;
-        break;
-      case 'N':
-        texture = &gui_assets.white_knight_texture;
-        break;
-      case 'p':
-        texture = &gui_assets.black_pawn_texture;
-        break;
-      case 'n':
-        texture = &gui_assets.black_knight_texture;
-        break;
-      default:
+    // Draw the clocks of timed players.
+    for (int turn = 1; turn >= 0; turn--) {
+      long remaining =
+          game_clock_remaining(&clock, turn, history_end_turn(&history));
+      if (remaining < 0)
         continue;
-      }
-
-      Rectangle rect;
-      if (last_move.to == position && anim_counter < MOVE_ANIM_FRAMES) {
-
-        Rectangle start_rect = pos_to_window_rect(last_move.from);
-        Rectangle end_rect = pos_to_window_rect(last_move.to);
-
-        rect = anim_linint(
-            start_rect, end_rect,
-            quad_interpolate((float)anim_counter / MOVE_ANIM_FRAMES));
 
-      } else if (position == selected_piece &&
-                 IsMouseButtonDown(MOUSE_BUTTON_LEFT)) {
-        int x = (int)(mouse_vec.x) - GRID_SQUARE_SIZE / 2;
-        int y = (int)(mouse_vec.y) - GRID_SQUARE_SIZE / 2;
-        rect = (Rectangle){x, y, GRID_SQUARE_SIZE, GRID_SQUARE_SIZE};
-
-      } else {
-        rect = pos_to_window_rect(position);
-      }
-
-      // Upsize the texture to the square size and draw it.
-      DrawTexturePro(*texture,
-                     (Rectangle){0, 0, texture->width, texture->height}, rect,
-                     (Vector2){0, 0}, 0, WHITE);
+      DrawText(TextFormat("%s %ld:%02ld.%ld", turn ? "White" : "Black",
+                          remaining / 60000, remaining / 1000 % 60,
+                          remaining / 100 % 10),
+               900, 300 + (1 - turn) * 30, 20, WHITE);
     }
 
-    // Draw indicators to available squares.
-    for (int i = 0; i < 4; i++) {
-      move move = available_moves[i];
-
-      if (!is_valid(move.from))
-        continue;
+    if (show_latency)
+      gui_draw_latency(&latency);
 
-      DrawTexturePro(gui_assets.circle_texture,
-                     (Rectangle){0, 0, gui_assets.circle_texture.width,
-                                 gui_assets.circle_texture.height},
-                     pos_to_window_rect(move.to), (Vector2){0, 0}, 0,
-                     CIRCLE_TO_COLOR);
-
-      if (is_valid(move.capture))
-        DrawTexturePro(gui_assets.circle_texture,
-                       (Rectangle){0, 0, gui_assets.circle_texture.width,
-                                   gui_assets.circle_texture.height},
-                       pos_to_window_rect(move.capture), (Vector2){0, 0}, 0,
-                       CIRCLE_CAPTURE_COLOR);
+    // The latency is measured up to handing the frame over to be presented.
+    uint64_t input_latency_ns = 0;
+    if (input.event_ns) {
+      input_latency_ns = timing_now_ns() - input.event_ns;
+      latency_add(&latency, input_latency_ns);
     }
 
-    // Draw status text.
-    const char *status_text = "<invalid>";
-    switch (board_status >> 4) {
-    case 0:
-      if (board_turn)
-        status_text = "White to play";
-      else
-        status_text = "Black to play";
-      break;
-    case 1:
-      status_text = "Draw";
-      break;
-    case 2:
-      status_text = "White wins";
-      break;
-    case 3:
-      status_text = "Black wins";
-      break;
+    // Only redraw often while something moves on the screen, or while the
+    // engines and spectators are waited on, as they are polled once a frame.
+    int target_frame_rate = IDLE_FRAME_RATE;
+    if (anim_progress < 1 || input.mouse_down || input.event_ns ||
+        search.state != SEARCH_IDLE || ponder_busy(&ponder) ||
+        analysis_busy(&analysis) || broadcast_backlogged(&spectators))
+      target_frame_rate = gui_refresh_rate();
+    if (target_frame_rate != frame_rate) {
+      SetTargetFPS(target_frame_rate);
+      frame_rate = target_frame_rate;
     }
-    DrawText(status_text, 900, 50, 30, WHITE);
 
     EndDrawing();
 
-    if (anim_counter < MOVE_ANIM_FRAMES) {
-      anim_counter++;
-    }
+    uint64_t now_ns = timing_now_ns();
+    stats_record_frame(now_ns - frame_end_ns);
+    replay_measure(&replay, now_ns - frame_end_ns, input_latency_ns);
+    frame_end_ns = now_ns;
+
+    // Raylib polls the events while ending the frame.
+    gui_input_clear(&input);
+    if (replay.mode != REPLAY_PLAYING)
+      gui_input_collect(&input);
   }
+  replay_close(&replay, frame);
+
+  if (latency.count) {
+    static const double fractions[] = {0.5, 0.9, 0.99, 1};
+    uint64_t results[4];
+    size_t count = latency_percentiles(&latency, fractions, results, 4);
+    fprintf(stderr,
+            "latency from poll: %zu inputs, p50 %.1f ms, p90 %.1f ms, "
+            "p99 %.1f ms, max %.1f ms\n",
+            count, results[0] / 1e6, results[1] / 1e6, results[2] / 1e6,
+            results[3] / 1e6);
+  }
+
+  // Save before the history is freed.
+  save_game();
 
-  // Make sure the jis process is no more.
+  // Make sure the jis processes are no more.
   jis_kill_proc(&process);
+  if (pondering)
+    ponder_free(&ponder);
+  analysis_free(&analysis);
+
+  history_free(&history);
+  book_close(&opening_book);
+  tablebase_free(&endgame_tables);
+  if (active_writer)
+    game_writer_close(active_writer);
+  broadcast_stop(&spectators);
 
   // Unload the assets.
   gui_unload_assets(&gui_assets);
@@ -0,0 +1,69 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "movecache.h"
+#include "hash.h"
+#include "jis_process.h"
+#include "position.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+static uint64_t entry_key(const char *board, bool turn, int square) {
+  uint64_t key =
+      board_hash(board, turn) ^ (uint64_t)(square + 1) * 0x9e3779b97f4a7c15;
+
+  // Zero marks empty entries.
+  return key ? key : 1;
+}
+
+bool move_cache_avail_moves(move_cache *cache, jis_process *process,
+                            const char *board, bool turn, int square,
+                            move moves[4]) {
+  uint64_t key = entry_key(board, turn, square);
+  move_cache_entry *entry = &cache->entries[key & (MOVE_CACHE_SIZE - 1)];
+
+  if (entry->key == key) {
+    cache->hits++;
+    for (int i = 0; i < 4; i++) {
+      if (i >= entry->count) {
+        moves[i] = (move){POSITION_INV};
+        continue;
+      }
+
+      moves[i] = (move){.from = entry->from,
+                        .to = entry->to[i],
+                        .capture = entry->capture[i]};
+      get_position_str(moves[i].from, moves[i].string);
+      get_position_str(moves[i].to, moves[i].string + 2);
+    }
+    return true;
+  }
+
+  cache->misses++;
+  for (int i = 0; i < 4; i++)
+    moves[i] = (move){POSITION_INV};
+  if (!jis_ask_avail_moves(process, square, moves))
+    return false;
+
+  *entry = (move_cache_entry){.key = key, .from = square};
+  for (int i = 0; i < 4 && is_valid(moves[i].from); i++) {
+    entry->to[i] = moves[i].to;
+    entry->capture[i] = moves[i].capture;
+    entry->count++;
+  }
+  return true;
+}
@@ -0,0 +1,53 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef MOVECACHE_H
+#define MOVECACHE_H
+
+#include "jis_process.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Number of entries, a power of two. Colliding entries replace each other.
+#define MOVE_CACHE_SIZE 4096
+
+// The moves of a single piece in a position. Squares are stored as in
+// positions, with POSITION_INV for missing captures.
+typedef struct {
+  // Hash of the position and the square, 0 if the entry is empty.
+  uint64_t key;
+  int8_t from;
+  uint8_t count;
+  int8_t to[4];
+  int8_t capture[4];
+  uint8_t reserved[6];
+} move_cache_entry;
+
+typedef struct {
+  move_cache_entry entries[MOVE_CACHE_SIZE];
+  size_t hits;
+  size_t misses;
+} move_cache;
+
+// Fill moves with the moves of the piece on square, asking the process only if
+// they are not cached. The process must be in the given position.
+bool move_cache_avail_moves(move_cache *cache, jis_process *process,
+                            const char *board, bool turn, int square,
+                            move moves[4]);
+
+#endif
@@ -0,0 +1,223 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "perft.h"
+#include "jis_process.h"
+#include "timing.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// More moves than any position of the game has.
+#define PERFT_MAX_MOVES 256
+
+typedef struct {
+  move move;
+
+  // The position after the move.
+  char board[64];
+  bool turn;
+  int status;
+
+  uint64_t nodes;
+} perft_root;
+
+typedef struct {
+  perft_root *roots;
+  int root_count;
+  int depth;
+
+  // Subtrees differ a lot in size, so workers take the next root when done
+  // instead of a fixed share.
+  atomic_int next_root;
+} perft_job;
+
+typedef struct {
+  perft_job *job;
+  jis_process process;
+
+  // Positions whose moves were listed.
+  uint64_t listed;
+  bool success;
+} perft_worker;
+
+// Add the positions depth plies after the position the engine is in, which is
+// board. The engine is left in an unknown position.
+static bool count_nodes(perft_worker *worker, char *board, bool turn,
+                        int depth, uint64_t *nodes) {
+  move moves[PERFT_MAX_MOVES];
+  int move_count = jis_ask_all_moves(&worker->process, board, turn, moves,
+                                     PERFT_MAX_MOVES);
+  if (move_count < 0)
+    return false;
+  worker->listed++;
+
+  // The last ply is only counted, not made.
+  if (depth == 1) {
+    *nodes += move_count;
+    return true;
+  }
+
+  for (int i = 0; i < move_count; i++) {
+    char next_board[64];
+    bool next_turn;
+    int next_status;
+    if (!jis_make_move(&worker->process, next_board, &next_turn, &next_status,
+                       moves[i].string))
+      return false;
+
+    // Finished games have no moves to count.
+    if (next_status >> 4 == 0 &&
+        !count_nodes(worker, next_board, next_turn, depth - 1, nodes))
+      return false;
+
+    if (i + 1 < move_count &&
+        !jis_load_position(&worker->process, board, turn))
+      return false;
+  }
+  return true;
+}
+
+static void *perft_worker_run(void *argument) {
+  perft_worker *worker = argument;
+  perft_job *job = worker->job;
+
+  int index;
+  while ((index = atomic_fetch_add(&job->next_root, 1)) < job->root_count) {
+    perft_root *root = &job->roots[index];
+
+    if (job->depth == 1) {
+      root->nodes = 1;
+      continue;
+    }
+    if (root->status >> 4)
+      continue;
+
+    if (!jis_load_position(&worker->process, root->board, root->turn) ||
+        !count_nodes(worker, root->board, root->turn, job->depth - 1,
+                     &root->nodes))
+      return NULL;
+  }
+
+  worker->success = true;
+  return NULL;
+}
+
+// Make every move of the starting position.
+static int list_roots(const char *executable, perft_root *roots) {
+  jis_process process = {.child_executable = executable};
+  if (!jis_create_proc(&process))
+    return -1;
+
+  char board[64];
+  bool turn;
+  int status;
+  move moves[PERFT_MAX_MOVES];
+  int move_count = -1;
+  if (jis_copy_position(&process, board, &turn, &status))
+    move_count =
+        jis_ask_all_moves(&process, board, turn, moves, PERFT_MAX_MOVES);
+
+  for (int i = 0; i < move_count; i++) {
+    roots[i] = (perft_root){.move = moves[i]};
+    if (!jis_make_move(&process, roots[i].board, &roots[i].turn,
+                       &roots[i].status, moves[i].string) ||
+        !jis_load_position(&process, board, turn)) {
+      move_count = -1;
+      break;
+    }
+  }
+
+  jis_kill_proc(&process);
+  return move_count;
+}
+
+bool perft_run(const char *executable, int depth, int thread_count) {
+  if (depth < 1) {
+    fprintf(stderr, "error: the depth must be at least 1\n");
+    return false;
+  }
+
+  perft_root roots[PERFT_MAX_MOVES];
+  perft_job job = {.roots = roots, .depth = depth};
+  job.root_count = list_roots(executable, roots);
+  if (job.root_count < 0)
+    return false;
+
+  // Every worker needs a subtree of its own.
+  int worker_count = thread_count < job.root_count ? thread_count
+                                                   : job.root_count;
+  if (worker_count < 1)
+    worker_count = 1;
+
+  perft_worker workers[worker_count];
+  pthread_t threads[worker_count];
+  int started = 0;
+  bool success = true;
+
+  uint64_t start_ns = timing_now_ns();
+
+  for (; started < worker_count; started++) {
+    workers[started] = (perft_worker){
+        .job = &job,
+        .process = {.child_executable = executable},
+    };
+    if (!jis_create_proc(&workers[started].process)) {
+      success = false;
+      break;
+    }
+    if (pthread_create(&threads[started], NULL, perft_worker_run,
+                       &workers[started])) {
+      fprintf(stderr, "error: pthread_create failed\n");
+      jis_kill_proc(&workers[started].process);
+      success = false;
+      break;
+    }
+  }
+
+  uint64_t listed = 0;
+  for (int i = 0; i < started; i++) {
+    pthread_join(threads[i], NULL);
+    jis_kill_proc(&workers[i].process);
+    success = success && workers[i].success;
+    listed += workers[i].listed;
+  }
+
+  uint64_t elapsed_ns = timing_now_ns() - start_ns;
+  if (!success) {
+    fprintf(stderr, "error: perft failed\n");
+    return false;
+  }
+
+  uint64_t nodes = 0;
+  for (int i = 0; i < job.root_count; i++) {
+    printf("%s %" PRIu64 "\n", roots[i].move.string, roots[i].nodes);
+    nodes += roots[i].nodes;
+  }
+
+  printf("perft: depth %d, %d engines, %" PRIu64 " nodes, %" PRIu64
+         " positions listed\n",
+         depth, worker_count, nodes, listed);
+  printf("perft: %.1f ms, %.0f nodes/s\n", elapsed_ns / 1e6,
+         nodes / (elapsed_ns / 1e9));
+  return true;
+}
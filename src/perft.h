@@ -0,0 +1,28 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef PERFT_H
+#define PERFT_H
+
+#include <stdbool.h>
+
+// Count the positions reached after depth plies from the starting position,
+// listing and making every move through the engine protocol. The subtrees of
+// the root moves are shared out to thread_count threads with an engine each.
+// Prints the count of every root move, the total and the rate of nodes.
+bool perft_run(const char *executable, int depth, int thread_count);
+
+#endif
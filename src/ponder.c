@@ -0,0 +1,116 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "ponder.h"
+#include "jis_process.h"
+#include "search.h"
+#include "timing.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+bool ponder_init(ponder *ponder, const char *executable) {
+  memset(ponder, 0, sizeof(*ponder));
+  ponder->process.child_executable = executable;
+  ponder->search.process = &ponder->process;
+  ponder->search.state = SEARCH_IDLE;
+  return jis_create_proc(&ponder->process);
+}
+
+void ponder_free(ponder *ponder) { jis_kill_proc(&ponder->process); }
+
+void ponder_start(ponder *ponder, char *board, bool board_turn) {
+  ponder_stop(ponder);
+
+  // Do not block on the previous search, start after it is drained.
+  memcpy(ponder->board, board, sizeof(ponder->board));
+  ponder->board_turn = board_turn;
+  ponder->start_pending = true;
+}
+
+bool ponder_update(ponder *ponder) {
+  char move_string[8];
+  jis_search_result result =
+      jis_search_poll(&ponder->search, move_string, sizeof(move_string));
+
+  if (result == SEARCH_ERROR)
+    return false;
+  if (result == SEARCH_TIMEOUT)
+    ponder->late = true;
+
+  if (ponder->start_pending && ponder->search.state == SEARCH_IDLE) {
+    ponder->start_pending = false;
+
+    if (!jis_load_position(&ponder->process, ponder->board,
+                           ponder->board_turn) ||
+        !jis_search_start(&ponder->search, -1))
+      return false;
+
+    ponder->state = PONDER_PREDICTING;
+    return true;
+  }
+
+  if (result != SEARCH_DONE)
+    return true;
+
+  switch (ponder->state) {
+  case PONDER_PREDICTING:
+    // Assume the user plays the move the engine would, and search an answer.
+    strcpy(ponder->predicted, move_string);
+    if (!jis_send(&ponder->process, "makemove %s\n", move_string) ||
+        !jis_search_start(&ponder->search, -1))
+      return false;
+
+    ponder->state = PONDER_SEARCHING;
+    break;
+
+  case PONDER_SEARCHING:
+    strcpy(ponder->answer, move_string);
+    ponder->state = PONDER_READY;
+    break;
+
+  default:
+    break;
+  }
+
+  return true;
+}
+
+bool ponder_user_moved(ponder *ponder, const char *move_string,
+                       long budget_ms) {
+  if ((ponder->state == PONDER_SEARCHING || ponder->state == PONDER_READY) &&
+      strcmp(ponder->predicted, move_string) == 0) {
+    ponder->hit = true;
+
+    // The time pondered so far is free, the move starts now.
+    if (ponder->state == PONDER_SEARCHING)
+      ponder->search.deadline_ms =
+          budget_ms < 0 ? 0 : timing_now_ms() + budget_ms;
+    return true;
+  }
+
+  ponder_stop(ponder);
+  return false;
+}
+
+void ponder_stop(ponder *ponder) {
+  jis_search_cancel(&ponder->search);
+  ponder->state = PONDER_IDLE;
+  ponder->start_pending = false;
+  ponder->hit = false;
+  ponder->late = false;
+}
@@ -0,0 +1,83 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef PONDER_H
+#define PONDER_H
+
+#include "jis_process.h"
+#include "search.h"
+
+#include <stdbool.h>
+
+typedef enum {
+  PONDER_IDLE,
+  // Searching the reply the user is expected to play.
+  PONDER_PREDICTING,
+  // Searching the answer to the predicted reply.
+  PONDER_SEARCHING,
+  PONDER_READY,
+} ponder_state;
+
+// Thinks on the time of the user with a second engine process, so the main
+// process stays available for the queries of the user interface.
+typedef struct {
+  jis_process process;
+  jis_search search;
+  ponder_state state;
+
+  // Position to ponder on once the previous search is drained.
+  bool start_pending;
+  char board[64];
+  bool board_turn;
+
+  // The user played the predicted move.
+  bool hit;
+
+  // The answer after a hit ran past the budget of the move, and is still
+  // searched for.
+  bool late;
+
+  char predicted[8];
+  char answer[8];
+} ponder;
+
+// Spawn the pondering process.
+bool ponder_init(ponder *ponder, const char *executable);
+
+void ponder_free(ponder *ponder);
+
+// Start pondering on the position where the user is to move.
+void ponder_start(ponder *ponder, char *board, bool board_turn);
+
+// Advance the pondering without blocking.
+bool ponder_update(ponder *ponder);
+
+// Tell the ponderer which move the user made. Returns true if it was the
+// predicted one, in which case the answer will be available once the state
+// becomes PONDER_READY. The rest of its search then has budget_ms, as a search
+// started for the move would, or no limit if budget_ms is negative.
+bool ponder_user_moved(ponder *ponder, const char *move_string,
+                       long budget_ms);
+
+// Abandon pondering.
+void ponder_stop(ponder *ponder);
+
+// Whether a search is running, being drained or waiting to start.
+static inline bool ponder_busy(ponder *ponder) {
+  return ponder->start_pending || ponder->search.state != SEARCH_IDLE;
+}
+
+#endif
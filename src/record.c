@@ -0,0 +1,454 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "record.h"
+#include "fen.h"
+#include "history.h"
+#include "jis_process.h"
+#include "position.h"
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// An index file starts with the magic, a version byte, and the size, the
+// modification time in nanoseconds and the number of games of the archive it
+// was built from.
+#define INDEX_MAGIC "JISI"
+#define INDEX_VERSION 2
+#define INDEX_HEADER_SIZE 32
+
+static void put_u16(uint8_t *buffer, uint16_t value) {
+  buffer[0] = value;
+  buffer[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *buffer, uint32_t value) {
+  put_u16(buffer, value);
+  put_u16(buffer + 2, value >> 16);
+}
+
+static uint16_t get_u16(const uint8_t *buffer) {
+  return buffer[0] | buffer[1] << 8;
+}
+
+static uint32_t get_u32(const uint8_t *buffer) {
+  return get_u16(buffer) | (uint32_t)get_u16(buffer + 2) << 16;
+}
+
+// The square between from and to, if there is one.
+static int between(int from, int to) {
+  int row = to_row(from) + to_row(to);
+  int col = to_col(from) + to_col(to);
+  if (row % 2 || col % 2)
+    return POSITION_INV;
+  return to_position(row / 2, col / 2);
+}
+
+int record_pack_move(move move, uint16_t words[2]) {
+  int code;
+  if (!is_valid(move.capture))
+    code = RECORD_CAPTURE_NONE;
+  else if (move.capture == move.to)
+    code = RECORD_CAPTURE_TO;
+  else if (move.capture == between(move.from, move.to))
+    code = RECORD_CAPTURE_BETWEEN;
+  else
+    code = RECORD_CAPTURE_ESCAPE;
+
+  words[0] = move.from | move.to << 6 | code << 12;
+  if (code != RECORD_CAPTURE_ESCAPE)
+    return 1;
+
+  words[1] = move.capture;
+  return 2;
+}
+
+int record_unpack_move(const uint16_t *words, size_t word_count, move *move) {
+  if (!word_count)
+    return 0;
+
+  move->from = words[0] & 63;
+  move->to = words[0] >> 6 & 63;
+
+  int used = 1;
+  switch (words[0] >> 12) {
+  case RECORD_CAPTURE_NONE:
+    move->capture = POSITION_INV;
+    break;
+  case RECORD_CAPTURE_TO:
+    move->capture = move->to;
+    break;
+  case RECORD_CAPTURE_BETWEEN:
+    move->capture = between(move->from, move->to);
+    break;
+  case RECORD_CAPTURE_ESCAPE:
+    if (word_count < 2 || !is_valid(words[1]))
+      return 0;
+    move->capture = words[1];
+    used = 2;
+    break;
+  default:
+    return 0;
+  }
+
+  // Moves are written as the from and to squares.
+  get_position_str(move->from, move->string);
+  get_position_str(move->to, move->string + 2);
+  return used;
+}
+
+bool game_writer_open(game_writer *writer, const char *path) {
+  writer->fd = open(path, O_RDWR | O_CREAT, 0644);
+  writer->game_offset = -1;
+
+  if (writer->fd < 0) {
+    fprintf(stderr, "error: could not open %s\n", path);
+    perror("open");
+    return false;
+  }
+
+  uint8_t header[RECORD_HEADER_SIZE];
+  ssize_t length = pread(writer->fd, header, sizeof(header), 0);
+
+  if (length == 0) {
+    // A new archive, write the header.
+    memset(header, 0, sizeof(header));
+    memcpy(header, RECORD_MAGIC, 4);
+    header[4] = RECORD_VERSION;
+
+    if (pwrite(writer->fd, header, sizeof(header), 0) !=
+        (ssize_t)sizeof(header)) {
+      fprintf(stderr, "error: could not write to %s\n", path);
+      perror("pwrite");
+      close(writer->fd);
+      return false;
+    }
+  } else if (length != sizeof(header) || memcmp(header, RECORD_MAGIC, 4) ||
+             header[4] != RECORD_VERSION) {
+    fprintf(stderr, "error: %s is not a game archive\n", path);
+    close(writer->fd);
+    return false;
+  }
+
+  return true;
+}
+
+void game_writer_close(game_writer *writer) { close(writer->fd); }
+
+static bool write_game_header(game_writer *writer, int result) {
+  uint8_t header[RECORD_GAME_HEADER_SIZE];
+  header[0] = 'G';
+  header[1] = result;
+  header[2] = writer->fen_length;
+  header[3] = 0;
+  put_u32(header + 4, writer->ply_count);
+  put_u32(header + 8, writer->move_bytes);
+
+  if (pwrite(writer->fd, header, sizeof(header), writer->game_offset) !=
+      (ssize_t)sizeof(header)) {
+    fprintf(stderr, "error: could not write game header\n");
+    perror("pwrite");
+    return false;
+  }
+  return true;
+}
+
+static bool append(game_writer *writer, const void *data, size_t size) {
+  off_t end = lseek(writer->fd, 0, SEEK_END);
+  if (end < 0 || write(writer->fd, data, size) != (ssize_t)size) {
+    fprintf(stderr, "error: could not append to game archive\n");
+    perror("write");
+    return false;
+  }
+  return true;
+}
+
+bool game_writer_begin(game_writer *writer, char *board, bool turn) {
+  char fen[128];
+  writer->fen_length = get_fen_string(fen, board, turn) - fen;
+
+  writer->game_offset = lseek(writer->fd, 0, SEEK_END);
+  writer->ply_count = 0;
+  writer->move_bytes = 0;
+
+  if (writer->game_offset < 0) {
+    perror("lseek");
+    return false;
+  }
+
+  return write_game_header(writer, 0) &&
+         append(writer, fen, writer->fen_length);
+}
+
+bool game_writer_begin_history(game_writer *writer, history *history) {
+  if (!game_writer_begin(writer, history->snapshots[0].board,
+                         history->snapshots[0].turn))
+    return false;
+
+  for (size_t ply = 0; ply < history->cursor; ply++) {
+    if (!game_writer_add(writer, history->entries[ply].move,
+                         history->entries[ply].status))
+      return false;
+  }
+  return true;
+}
+
+bool game_writer_add(game_writer *writer, move move, int status) {
+  if (writer->game_offset < 0) {
+    fprintf(stderr, "error: adding a move without a game\n");
+    return false;
+  }
+
+  uint16_t words[2];
+  int word_count = record_pack_move(move, words);
+
+  uint8_t buffer[4];
+  for (int i = 0; i < word_count; i++)
+    put_u16(buffer + i * 2, words[i]);
+
+  if (!append(writer, buffer, word_count * 2))
+    return false;
+
+  writer->ply_count++;
+  writer->move_bytes += word_count * 2;
+  return write_game_header(writer, status >> 4);
+}
+
+bool game_writer_set_result(game_writer *writer, int status) {
+  return writer->game_offset >= 0 &&
+         write_game_header(writer, status >> 4);
+}
+
+// Check that a whole game record starts at offset, and find where it ends.
+static bool game_at(game_archive *archive, size_t offset, size_t *next) {
+  if (offset + RECORD_GAME_HEADER_SIZE > archive->size)
+    return false;
+
+  const uint8_t *header = archive->data + offset;
+  if (header[0] != 'G' || header[3] != 0)
+    return false;
+
+  *next = offset + RECORD_GAME_HEADER_SIZE + header[2] + get_u32(header + 8);
+  if (*next > archive->size)
+    return false;
+
+  // Every record starts from a position, which makes it unlikely to find one
+  // by chance in the middle of the moves of another.
+  char fen[256], board[64];
+  bool turn;
+  memcpy(fen, header + RECORD_GAME_HEADER_SIZE, header[2]);
+  fen[header[2]] = '\0';
+  return load_fen(fen, board, &turn);
+}
+
+// Build the offset index by walking the game headers.
+static bool build_index(game_archive *archive) {
+  size_t capacity = 1024;
+  archive->index_buffer = malloc(capacity * sizeof(uint64_t));
+  archive->game_count = 0;
+
+  if (!archive->index_buffer) {
+    fprintf(stderr, "error: malloc failed\n");
+    perror("malloc");
+    return false;
+  }
+
+  size_t offset = RECORD_HEADER_SIZE;
+  while (offset + RECORD_GAME_HEADER_SIZE <= archive->size) {
+    // A writer that stopped between appending a move and updating the header
+    // leaves a torn record, and the last game may still be being written.
+    // Look for the next whole record past it.
+    size_t next;
+    if (!game_at(archive, offset, &next)) {
+      offset++;
+      continue;
+    }
+
+    if (archive->game_count == capacity) {
+      capacity *= 2;
+      uint64_t *new_buffer =
+          realloc(archive->index_buffer, capacity * sizeof(uint64_t));
+      if (!new_buffer) {
+        fprintf(stderr, "error: realloc failed\n");
+        perror("realloc");
+        return false;
+      }
+      archive->index_buffer = new_buffer;
+    }
+
+    archive->index_buffer[archive->game_count++] = offset;
+    offset = next;
+  }
+
+  archive->offsets = archive->index_buffer;
+  return true;
+}
+
+// Try to map an index file that matches the archive.
+static bool map_index(game_archive *archive, const char *index_path) {
+  int fd = open(index_path, O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat stat;
+  if (fstat(fd, &stat) < 0 || stat.st_size < INDEX_HEADER_SIZE) {
+    close(fd);
+    return false;
+  }
+
+  void *map = mmap(NULL, stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return false;
+
+  // The size alone would miss an archive rewritten to the same size.
+  const uint64_t *header = map;
+  if (memcmp(map, INDEX_MAGIC, 4) ||
+      ((const uint8_t *)map)[4] != INDEX_VERSION ||
+      header[1] != archive->size || header[2] != archive->mtime_ns ||
+      stat.st_size != INDEX_HEADER_SIZE + header[3] * sizeof(uint64_t)) {
+    munmap(map, stat.st_size);
+    return false;
+  }
+
+  archive->index_map = map;
+  archive->index_map_size = stat.st_size;
+  archive->game_count = header[3];
+  archive->offsets = header + INDEX_HEADER_SIZE / sizeof(uint64_t);
+  return true;
+}
+
+// Save the index next to the archive. Failing to do so is not an error, the
+// index is rebuilt next time.
+static void save_index(game_archive *archive, const char *index_path) {
+  char temp_path[strlen(index_path) + 8];
+  strcpy(temp_path, index_path);
+  strcat(temp_path, ".tmp");
+
+  FILE *file = fopen(temp_path, "wb");
+  if (!file)
+    return;
+
+  uint64_t header[4] = {0, archive->size, archive->mtime_ns,
+                        archive->game_count};
+  memcpy(header, INDEX_MAGIC, 4);
+  ((uint8_t *)header)[4] = INDEX_VERSION;
+
+  bool success = fwrite(header, sizeof(header), 1, file) == 1 &&
+                 fwrite(archive->offsets, sizeof(uint64_t),
+                        archive->game_count, file) == archive->game_count;
+
+  if (fclose(file) || !success || rename(temp_path, index_path) < 0)
+    unlink(temp_path);
+}
+
+bool game_archive_open(game_archive *archive, const char *path) {
+  memset(archive, 0, sizeof(*archive));
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "error: could not open %s\n", path);
+    perror("open");
+    return false;
+  }
+
+  struct stat stat;
+  if (fstat(fd, &stat) < 0 || stat.st_size < RECORD_HEADER_SIZE) {
+    fprintf(stderr, "error: %s is not a game archive\n", path);
+    close(fd);
+    return false;
+  }
+
+  archive->size = stat.st_size;
+  archive->mtime_ns =
+      (uint64_t)stat.st_mtim.tv_sec * 1000000000 + stat.st_mtim.tv_nsec;
+  void *map = mmap(NULL, archive->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "error: could not map %s\n", path);
+    perror("mmap");
+    return false;
+  }
+  archive->data = map;
+
+  if (memcmp(archive->data, RECORD_MAGIC, 4) ||
+      archive->data[4] != RECORD_VERSION) {
+    fprintf(stderr, "error: %s is not a game archive\n", path);
+    game_archive_close(archive);
+    return false;
+  }
+
+  char index_path[strlen(path) + 8];
+  strcpy(index_path, path);
+  strcat(index_path, ".idx");
+
+  if (map_index(archive, index_path))
+    return true;
+
+  if (!build_index(archive)) {
+    game_archive_close(archive);
+    return false;
+  }
+
+  save_index(archive, index_path);
+  return true;
+}
+
+void game_archive_close(game_archive *archive) {
+  if (archive->data)
+    munmap((void *)archive->data, archive->size);
+  if (archive->index_map)
+    munmap(archive->index_map, archive->index_map_size);
+  free(archive->index_buffer);
+}
+
+bool game_archive_get(game_archive *archive, size_t index,
+                      game_record *record) {
+  if (index >= archive->game_count) {
+    fprintf(stderr, "error: there are only %zu games\n", archive->game_count);
+    return false;
+  }
+
+  const uint8_t *header = archive->data + archive->offsets[index];
+  int fen_length = header[2];
+
+  memcpy(record->fen, header + RECORD_GAME_HEADER_SIZE, fen_length);
+  record->fen[fen_length] = '\0';
+  record->result = header[1];
+  record->ply_count = get_u32(header + 4);
+  record->moves = header + RECORD_GAME_HEADER_SIZE + fen_length;
+  record->move_bytes = get_u32(header + 8);
+  return true;
+}
+
+bool game_record_next_move(game_record *record, size_t *offset, move *move) {
+  uint16_t words[2];
+  size_t word_count = 0;
+  for (; word_count < 2 && *offset + word_count * 2 + 2 <= record->move_bytes;
+       word_count++)
+    words[word_count] = get_u16(record->moves + *offset + word_count * 2);
+
+  int used = record_unpack_move(words, word_count, move);
+  *offset += used * 2;
+  return used;
+}
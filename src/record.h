@@ -0,0 +1,125 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef RECORD_H
+#define RECORD_H
+
+#include "history.h"
+#include "jis_process.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// An archive starts with an 8 byte header, followed by game records:
+//
+//   u8  'G'
+//   u8  result, the board status shifted right by 4
+//   u8  length of the starting FEN
+//   u8  reserved
+//   u32 number of moves
+//   u32 number of bytes used by the moves
+//   the starting FEN, without a terminator
+//   the packed moves
+//
+// Integers are little endian. A move is packed into 16 bits as the from
+// square, the to square shifted by 6 and a capture code shifted by 12. If the
+// capture can not be described by a code, RECORD_CAPTURE_ESCAPE is used and
+// the capture square follows in another 16 bits.
+#define RECORD_MAGIC "JISG"
+#define RECORD_VERSION 1
+
+#define RECORD_HEADER_SIZE 8
+#define RECORD_GAME_HEADER_SIZE 12
+
+#define RECORD_CAPTURE_NONE 0
+#define RECORD_CAPTURE_TO 1
+#define RECORD_CAPTURE_BETWEEN 2
+#define RECORD_CAPTURE_ESCAPE 15
+
+typedef struct {
+  int fd;
+
+  // Offset of the header of the game being written.
+  off_t game_offset;
+  uint8_t fen_length;
+  uint32_t ply_count;
+  uint32_t move_bytes;
+} game_writer;
+
+typedef struct {
+  const uint8_t *data;
+  size_t size;
+  // The modification time of the archive, to tell if the index is current.
+  uint64_t mtime_ns;
+
+  const uint64_t *offsets;
+  size_t game_count;
+
+  // Either the mapped index file or an index built in memory.
+  void *index_map;
+  size_t index_map_size;
+  uint64_t *index_buffer;
+} game_archive;
+
+typedef struct {
+  char fen[256];
+  int result;
+  uint32_t ply_count;
+
+  const uint8_t *moves;
+  size_t move_bytes;
+} game_record;
+
+// Pack a move into at most two 16 bit words, returning the number of words.
+int record_pack_move(move move, uint16_t words[2]);
+
+// Unpack a move, returning the number of words used or 0 on failure.
+int record_unpack_move(const uint16_t *words, size_t word_count, move *move);
+
+// Open an archive for appending.
+bool game_writer_open(game_writer *writer, const char *path);
+
+void game_writer_close(game_writer *writer);
+
+// Start a new game record from a position.
+bool game_writer_begin(game_writer *writer, char *board, bool turn);
+
+// Start a new game record containing the moves of the history up to the
+// cursor.
+bool game_writer_begin_history(game_writer *writer, history *history);
+
+// Append a move and the status it resulted in to the current game.
+bool game_writer_add(game_writer *writer, move move, int status);
+
+// Update the result of the current game, for games not ended by a move.
+bool game_writer_set_result(game_writer *writer, int status);
+
+// Map an archive into memory. The offset index is loaded from a ".idx" file
+// next to the archive, which is rebuilt if it is missing or stale. Torn
+// records are skipped when building the index.
+bool game_archive_open(game_archive *archive, const char *path);
+
+void game_archive_close(game_archive *archive);
+
+// Get a game by its index in constant time.
+bool game_archive_get(game_archive *archive, size_t index, game_record *record);
+
+// Decode the move at *offset bytes into the record and advance *offset.
+bool game_record_next_move(game_record *record, size_t *offset, move *move);
+
+#endif
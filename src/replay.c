@@ -0,0 +1,218 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "replay.h"
+#include "gui.h"
+#include "timing.h"
+#include "transcript.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool grow(void **array, size_t *capacity, size_t length, size_t size) {
+  if (length < *capacity)
+    return true;
+
+  size_t new_capacity = *capacity ? *capacity * 2 : 64;
+  void *new_array = realloc(*array, new_capacity * size);
+  if (!new_array) {
+    fprintf(stderr, "error: realloc failed\n");
+    perror("realloc");
+    return false;
+  }
+  *array = new_array;
+  *capacity = new_capacity;
+  return true;
+}
+
+bool replay_record(replay *replay, const char *path) {
+  memset(replay, 0, sizeof(*replay));
+
+  replay->file = fopen(path, "w");
+  if (!replay->file) {
+    fprintf(stderr, "error: could not open %s\n", path);
+    perror("fopen");
+    return false;
+  }
+
+  fprintf(replay->file, "%s\n", REPLAY_HEADER);
+  replay->mode = REPLAY_RECORDING;
+  transcript_set_file(replay->file);
+  return true;
+}
+
+bool replay_open(replay *replay, const char *path) {
+  memset(replay, 0, sizeof(*replay));
+
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    fprintf(stderr, "error: could not open %s\n", path);
+    perror("fopen");
+    return false;
+  }
+
+  char line[1024];
+  if (!fgets(line, sizeof(line), file) ||
+      strncmp(line, REPLAY_HEADER, strlen(REPLAY_HEADER))) {
+    fprintf(stderr, "error: %s is not a recorded session\n", path);
+    fclose(file);
+    return false;
+  }
+
+  size_t frame_capacity = 0, engine_capacity = 0;
+  bool ended = false;
+  while (fgets(line, sizeof(line), file)) {
+    replay_frame frame = {0};
+    int down, pressed, released;
+    unsigned keys;
+
+    if (sscanf(line, "i %zu %f %f %d %d %d %x", &frame.frame,
+               &frame.input.mouse.x, &frame.input.mouse.y, &down, &pressed,
+               &released, &keys) == 7) {
+      frame.input.mouse_down = down;
+      frame.input.mouse_pressed = pressed;
+      frame.input.mouse_released = released;
+      for (int key = 0; key < INPUT_KEY_COUNT; key++)
+        frame.input.keys_pressed[key] = keys >> key & 1;
+
+      if (!grow((void **)&replay->frames, &frame_capacity,
+                replay->frame_count, sizeof(replay_frame)))
+        break;
+      replay->frames[replay->frame_count++] = frame;
+
+    } else if (sscanf(line, "a %zu", &frame.frame) == 1) {
+      if (!grow((void **)&replay->engine_frames, &engine_capacity,
+                replay->engine_count, sizeof(size_t)))
+        break;
+      replay->engine_frames[replay->engine_count++] = frame.frame;
+
+    } else if (sscanf(line, "end %zu", &replay->end_frame) == 1) {
+      ended = true;
+    }
+  }
+  fclose(file);
+
+  if (!ended) {
+    fprintf(stderr, "error: %s is not a complete recorded session\n", path);
+    free(replay->frames);
+    free(replay->engine_frames);
+    return false;
+  }
+
+  replay->mode = REPLAY_PLAYING;
+  return true;
+}
+
+static void print_percentiles(const char *name, uint64_t *values,
+                              size_t count) {
+  static const double fractions[] = {0.5, 0.9, 0.99, 1};
+  uint64_t results[4];
+  timing_percentiles(values, count, fractions, results, 4);
+  printf("replay: %s of %zu, p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, "
+         "max %.2f ms\n",
+         name, count, results[0] / 1e6, results[1] / 1e6, results[2] / 1e6,
+         results[3] / 1e6);
+}
+
+void replay_close(replay *replay, size_t frame) {
+  if (replay->mode == REPLAY_RECORDING) {
+    fprintf(replay->file, "end %zu\n", frame);
+    transcript_set_file(NULL);
+    fclose(replay->file);
+
+  } else if (replay->mode == REPLAY_PLAYING) {
+    if (replay->next_engine < replay->engine_count)
+      printf("replay: %zu of %zu engine moves were not made again\n",
+             replay->engine_count - replay->next_engine,
+             replay->engine_count);
+
+    print_percentiles("frame times", replay->frame_ns,
+                      replay->measured_count);
+    print_percentiles("input latencies", replay->latency_ns,
+                      replay->latency_count);
+
+    free(replay->frames);
+    free(replay->engine_frames);
+    free(replay->frame_ns);
+    free(replay->latency_ns);
+  }
+  replay->mode = REPLAY_OFF;
+}
+
+void replay_input(replay *replay, size_t frame, gui_input *input) {
+  if (replay->mode == REPLAY_RECORDING) {
+    if (!input->event_ns)
+      return;
+
+    unsigned keys = 0;
+    for (int key = 0; key < INPUT_KEY_COUNT; key++)
+      keys |= input->keys_pressed[key] << key;
+    fprintf(replay->file, "i %zu %.1f %.1f %d %d %d %x\n", frame,
+            input->mouse.x, input->mouse.y, input->mouse_down,
+            input->mouse_pressed, input->mouse_released, keys);
+
+  } else if (replay->mode == REPLAY_PLAYING) {
+    // The mouse stays where the last recorded input left it.
+    Vector2 mouse = input->mouse;
+    bool mouse_down = input->mouse_down;
+    memset(input, 0, sizeof(*input));
+    input->mouse = mouse;
+    input->mouse_down = mouse_down;
+
+    if (replay->next_frame < replay->frame_count &&
+        replay->frames[replay->next_frame].frame <= frame) {
+      *input = replay->frames[replay->next_frame++].input;
+      input->event_ns = timing_now_ns();
+    }
+  }
+}
+
+bool replay_engine_due(replay *replay, size_t frame) {
+  if (replay->mode != REPLAY_PLAYING)
+    return true;
+  return replay->next_engine < replay->engine_count &&
+         replay->engine_frames[replay->next_engine] <= frame;
+}
+
+void replay_engine_moved(replay *replay, size_t frame) {
+  if (replay->mode == REPLAY_RECORDING)
+    fprintf(replay->file, "a %zu\n", frame);
+  else if (replay->mode == REPLAY_PLAYING)
+    replay->next_engine++;
+}
+
+bool replay_finished(replay *replay, size_t frame) {
+  return replay->mode == REPLAY_PLAYING && frame > replay->end_frame;
+}
+
+void replay_measure(replay *replay, uint64_t frame_ns, uint64_t latency_ns) {
+  if (replay->mode != REPLAY_PLAYING)
+    return;
+
+  size_t capacity = replay->measured_capacity;
+  if (!grow((void **)&replay->frame_ns, &capacity, replay->measured_count,
+            sizeof(uint64_t)) ||
+      !grow((void **)&replay->latency_ns, &replay->measured_capacity,
+            replay->measured_count, sizeof(uint64_t)))
+    return;
+
+  replay->frame_ns[replay->measured_count++] = frame_ns;
+  if (latency_ns)
+    replay->latency_ns[replay->latency_count++] = latency_ns;
+}
@@ -0,0 +1,97 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "gui.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// A recorded session is a text file of lines,
+//
+//   i frame x y down pressed released keys   input of a frame, keys as bits
+//   a frame                                  the engine moved in the frame
+//   end frame                                the session ended
+//
+// along with the traffic with the engines, as described in transcript.h. Only
+// frames with input events are recorded. The engine lines are what the
+// stand-in engine answers from when the session is replayed.
+#define REPLAY_HEADER "jis-replay 1"
+
+typedef enum {
+  REPLAY_OFF,
+  REPLAY_RECORDING,
+  REPLAY_PLAYING,
+} replay_mode;
+
+typedef struct {
+  size_t frame;
+  gui_input input;
+} replay_frame;
+
+typedef struct {
+  replay_mode mode;
+  FILE *file;
+
+  replay_frame *frames;
+  size_t frame_count;
+  size_t next_frame;
+
+  size_t *engine_frames;
+  size_t engine_count;
+  size_t next_engine;
+
+  size_t end_frame;
+
+  // Measurements of the replayed frames.
+  uint64_t *frame_ns;
+  uint64_t *latency_ns;
+  size_t measured_count;
+  size_t latency_count;
+  size_t measured_capacity;
+} replay;
+
+// Start recording the input and the engine traffic of the session to path.
+bool replay_record(replay *replay, const char *path);
+
+// Load a recorded session to be replayed. The engines must be the stand-in,
+// which is pointed at the same file.
+bool replay_open(replay *replay, const char *path);
+
+// Finish the recording, or print the measurements of the replay.
+void replay_close(replay *replay, size_t frame);
+
+// Record the input of the frame, or replace it with the recorded input.
+void replay_input(replay *replay, size_t frame, gui_input *input);
+
+// Whether the engine may move in the frame. When replaying, engine moves are
+// held back until the frame they were made in, and must be made in it.
+bool replay_engine_due(replay *replay, size_t frame);
+
+// Note that the engine moved in the frame.
+void replay_engine_moved(replay *replay, size_t frame);
+
+// Whether all recorded frames were replayed.
+bool replay_finished(replay *replay, size_t frame);
+
+// Measure a replayed frame and the latency of its input, 0 if it had none.
+void replay_measure(replay *replay, uint64_t frame_ns, uint64_t latency_ns);
+
+#endif
@@ -0,0 +1,190 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "search.h"
+#include "jis_process.h"
+#include "timing.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+void game_clock_init(game_clock *clock, long base_ms, long increment_ms,
+                     long movetime_ms) {
+  clock->remaining_ms[0] = base_ms;
+  clock->remaining_ms[1] = base_ms;
+  clock->increment_ms = increment_ms;
+  clock->movetime_ms = movetime_ms;
+  clock->turn_start_ms = timing_now_ms();
+  clock->pause_ms = 0;
+}
+
+void game_clock_start_turn(game_clock *clock) {
+  clock->turn_start_ms = timing_now_ms();
+  clock->pause_ms = 0;
+}
+
+void game_clock_pause(game_clock *clock) {
+  if (!clock->pause_ms)
+    clock->pause_ms = timing_now_ms();
+}
+
+void game_clock_resume(game_clock *clock) {
+  if (!clock->pause_ms)
+    return;
+
+  // The paused time is not charged to anyone.
+  clock->turn_start_ms += timing_now_ms() - clock->pause_ms;
+  clock->pause_ms = 0;
+}
+
+// Time spent by the side to move, not counting pauses.
+static long turn_elapsed(game_clock *clock) {
+  uint64_t now = clock->pause_ms ? clock->pause_ms : timing_now_ms();
+  return now - clock->turn_start_ms;
+}
+
+void game_clock_end_turn(game_clock *clock, bool turn) {
+  if (clock->remaining_ms[turn] >= 0) {
+    clock->remaining_ms[turn] -= turn_elapsed(clock);
+
+    // Do not let the increment bring back a player whose flag fell.
+    if (clock->remaining_ms[turn] < 0)
+      clock->remaining_ms[turn] = 0;
+    else
+      clock->remaining_ms[turn] += clock->increment_ms;
+  }
+
+  game_clock_start_turn(clock);
+}
+
+long game_clock_budget(game_clock *clock, bool turn) {
+  long budget = clock->remaining_ms[turn];
+
+  if (clock->movetime_ms > 0 && (budget < 0 || clock->movetime_ms < budget))
+    budget = clock->movetime_ms;
+
+  if (budget < 0)
+    return -1;
+
+  budget -= turn_elapsed(clock);
+  return budget < 0 ? 0 : budget;
+}
+
+long game_clock_remaining(game_clock *clock, bool turn, bool board_turn) {
+  long remaining = clock->remaining_ms[turn];
+  if (remaining < 0 || turn != board_turn)
+    return remaining;
+
+  remaining -= turn_elapsed(clock);
+  return remaining < 0 ? 0 : remaining;
+}
+
+bool game_clock_flagged(game_clock *clock, bool turn) {
+  return clock->remaining_ms[turn] >= 0 &&
+         game_clock_remaining(clock, turn, turn) == 0;
+}
+
+bool jis_search_start(jis_search *search, long budget_ms) {
+  // The previous search must be drained before its reply is mistaken for the
+  // reply of this one.
+  if (!jis_search_sync(search))
+    return false;
+
+  search->start_ms = timing_now_ms();
+  search->deadline_ms = budget_ms < 0 ? 0 : search->start_ms + budget_ms;
+  search->state = SEARCH_RUNNING;
+
+  jis_start_eval_r(search->process);
+  return true;
+}
+
+jis_search_result jis_search_poll(jis_search *search, char *reply,
+                                  size_t reply_size) {
+  if (search->state == SEARCH_IDLE)
+    return SEARCH_NONE;
+
+  int result = jis_poll(search->process);
+  if (result < 0)
+    return SEARCH_ERROR;
+
+  if (search->state == SEARCH_DRAINING) {
+    if (result > 0) {
+      char buffer[256];
+      if (jis_read(search->process, buffer, sizeof(buffer)) < 0)
+        return SEARCH_ERROR;
+      search->state = SEARCH_IDLE;
+    }
+    return SEARCH_NONE;
+  }
+
+  if (result > 0) {
+    search->state = SEARCH_IDLE;
+    if (jis_read(search->process, reply, reply_size) < 0)
+      return SEARCH_ERROR;
+    return SEARCH_DONE;
+  }
+
+  if (search->deadline_ms && timing_now_ms() >= search->deadline_ms) {
+    search->deadline_ms = 0;
+    return SEARCH_TIMEOUT;
+  }
+
+  return SEARCH_PENDING;
+}
+
+jis_search_result jis_search_wait(jis_search *search, char *reply,
+                                  size_t reply_size) {
+  if (search->state == SEARCH_IDLE)
+    return SEARCH_NONE;
+  if (search->state == SEARCH_DRAINING)
+    return jis_search_sync(search) ? SEARCH_NONE : SEARCH_ERROR;
+
+  search->state = SEARCH_IDLE;
+  if (jis_read(search->process, reply, reply_size) < 0)
+    return SEARCH_ERROR;
+  return SEARCH_DONE;
+}
+
+void jis_search_cancel(jis_search *search) {
+  if (search->state == SEARCH_RUNNING)
+    search->state = SEARCH_DRAINING;
+}
+
+bool jis_search_abort(jis_search *search) {
+  if (search->state == SEARCH_IDLE)
+    return true;
+
+  search->state = SEARCH_IDLE;
+  return jis_restart_proc(search->process);
+}
+
+bool jis_search_sync(jis_search *search) {
+  if (search->state == SEARCH_IDLE)
+    return true;
+
+  if (search->state == SEARCH_RUNNING) {
+    fprintf(stderr, "error: synchronizing with a running search\n");
+    return false;
+  }
+
+  // Block until the abandoned reply arrives, and throw it away.
+  char buffer[256];
+  if (jis_read(search->process, buffer, sizeof(buffer)) < 0)
+    return false;
+
+  search->state = SEARCH_IDLE;
+  return true;
+}
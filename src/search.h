@@ -0,0 +1,125 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "jis_process.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Time control shared by both players. Arrays are indexed by the board turn,
+// so index 1 is white. A negative remaining time means the side is untimed.
+typedef struct {
+  long remaining_ms[2];
+  long increment_ms;
+
+  // Upper bound of a single move, 0 if there is no per move limit.
+  long movetime_ms;
+
+  // When the side to move started thinking.
+  uint64_t turn_start_ms;
+
+  // When the clock was paused, 0 if it is running.
+  uint64_t pause_ms;
+} game_clock;
+
+typedef enum {
+  SEARCH_IDLE,
+  SEARCH_RUNNING,
+
+  // The search was cancelled but its reply is still on the way. The process
+  // can not be asked anything else until the reply is drained.
+  SEARCH_DRAINING,
+} jis_search_state;
+
+typedef enum {
+  SEARCH_NONE,
+  SEARCH_PENDING,
+  SEARCH_DONE,
+  SEARCH_TIMEOUT,
+  SEARCH_ERROR,
+} jis_search_result;
+
+typedef struct {
+  jis_process *process;
+  jis_search_state state;
+
+  uint64_t start_ms;
+  // 0 if the search may run forever.
+  uint64_t deadline_ms;
+} jis_search;
+
+// Initialize a clock with the same time for both sides. A negative base_ms
+// creates an untimed clock.
+void game_clock_init(game_clock *clock, long base_ms, long increment_ms,
+                     long movetime_ms);
+
+// Start counting the time of the side to move.
+void game_clock_start_turn(game_clock *clock);
+
+// Stop counting the time of the side to move, until game_clock_resume. Both
+// do nothing if the clock is already paused or running.
+void game_clock_pause(game_clock *clock);
+
+void game_clock_resume(game_clock *clock);
+
+// Charge the time spent since game_clock_start_turn to the player and start
+// the turn of the opponent.
+void game_clock_end_turn(game_clock *clock, bool turn);
+
+// Time a search of the player may still take on the current move, including
+// the move time, or -1 if unlimited.
+long game_clock_budget(game_clock *clock, bool turn);
+
+// Remaining time of a player, including the running turn.
+long game_clock_remaining(game_clock *clock, bool turn, bool board_turn);
+
+// Check if the player to move ran out of time on the clock. The move time only
+// bounds searches and is not checked here.
+bool game_clock_flagged(game_clock *clock, bool turn);
+
+// Start a search which should complete in budget_ms milliseconds, or without
+// a limit if budget_ms is negative. The protocol has no way to limit the nodes
+// of a search, so budgets are only in time.
+bool jis_search_start(jis_search *search, long budget_ms);
+
+// Check the search without blocking. On SEARCH_DONE the reply, the generated
+// move or the score, is copied to reply. SEARCH_TIMEOUT is returned once, when
+// the deadline passes, after which the search keeps running without one until
+// it is done or cancelled.
+jis_search_result jis_search_poll(jis_search *search, char *reply,
+                                  size_t reply_size);
+
+// Block until the search is done, ignoring its deadline. An abandoned search
+// is drained instead, which returns SEARCH_NONE.
+jis_search_result jis_search_wait(jis_search *search, char *reply,
+                                  size_t reply_size);
+
+// Abandon the running search. Its reply is drained in the following polls, so
+// the process stays usable without being respawned.
+void jis_search_cancel(jis_search *search);
+
+// Abandon the running search by restarting its process, so that it can be
+// asked again at once. The new process has to be told the position.
+bool jis_search_abort(jis_search *search);
+
+// Block until the process is ready for new commands.
+bool jis_search_sync(jis_search *search);
+
+#endif
@@ -0,0 +1,308 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "session.h"
+#include "fen.h"
+#include "history.h"
+#include "movecache.h"
+#include "record.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A move of the history and the state after it. The squares it changed follow
+// the earlier ones in the change section.
+typedef struct {
+  uint16_t words[2];
+  uint8_t turn;
+  uint8_t status;
+  uint8_t change_count;
+  uint8_t reserved;
+} session_ply;
+
+typedef struct {
+  uint8_t position;
+  char after;
+} session_change;
+
+// Header fields are copied, as the header is a char array with no alignment.
+// Like the rest of the file, they are in the byte order of the machine.
+static void put_u16(char *buffer, uint16_t value) {
+  memcpy(buffer, &value, sizeof(value));
+}
+
+static void put_u32(char *buffer, uint32_t value) {
+  memcpy(buffer, &value, sizeof(value));
+}
+
+static void put_i64(char *buffer, int64_t value) {
+  memcpy(buffer, &value, sizeof(value));
+}
+
+static uint16_t get_u16(const char *buffer) {
+  uint16_t value;
+  memcpy(&value, buffer, sizeof(value));
+  return value;
+}
+
+static uint32_t get_u32(const char *buffer) {
+  uint32_t value;
+  memcpy(&value, buffer, sizeof(value));
+  return value;
+}
+
+static int64_t get_i64(const char *buffer) {
+  int64_t value;
+  memcpy(&value, buffer, sizeof(value));
+  return value;
+}
+
+bool session_save(const char *path, history *history, const move_cache *cache,
+                  const session_settings *settings) {
+  size_t cursor = history->cursor;
+  session_ply *plies = malloc(history->length * sizeof(session_ply) + 1);
+  session_change *changes =
+      malloc(history->length * 64 * sizeof(session_change) + 1);
+  if (!plies || !changes) {
+    fprintf(stderr, "error: malloc failed\n");
+    perror("malloc");
+    free(plies);
+    free(changes);
+    return false;
+  }
+
+  // Walk the history to find the squares every move changed.
+  char start_fen[128];
+  history_go(history, 0);
+  get_fen_string(start_fen, history->board, history->turn);
+  int start_status = history->status;
+
+  char board[64];
+  memcpy(board, history->board, sizeof(board));
+  size_t change_count = 0;
+
+  for (size_t ply = 0; ply < history->length; ply++) {
+    history_go(history, ply + 1);
+
+    session_ply *record = &plies[ply];
+    *record = (session_ply){.turn = history->turn,
+                            .status = history->status};
+    record_pack_move(history->entries[ply].move, record->words);
+
+    for (int position = 0; position < 64; position++) {
+      if (board[position] == history->board[position])
+        continue;
+      changes[change_count++] =
+          (session_change){position, history->board[position]};
+      record->change_count++;
+    }
+    memcpy(board, history->board, sizeof(board));
+  }
+
+  char end_fen[128];
+  get_fen_string(end_fen, history->board, history->turn);
+  history_go(history, cursor);
+
+  uint32_t cache_count = 0;
+  for (size_t i = 0; i < MOVE_CACHE_SIZE; i++)
+    cache_count += cache->entries[i].key != 0;
+
+  char header[SESSION_HEADER_SIZE] = {0};
+  memcpy(header, SESSION_MAGIC, 4);
+  put_u32(header + 4, SESSION_VERSION);
+  put_u32(header + 8, history->length);
+  put_u32(header + 12, cursor);
+  put_u32(header + 16, change_count);
+  put_u32(header + 20, cache_count);
+  put_u16(header + 24, strlen(start_fen));
+  put_u16(header + 26, strlen(end_fen));
+  header[28] = settings->engine_plays[0] | settings->engine_plays[1] << 1;
+  header[29] = settings->analysing;
+  header[30] = settings->lost_on_time;
+  header[31] = start_status;
+  put_i64(header + 32, settings->remaining_ms[0]);
+  put_i64(header + 40, settings->remaining_ms[1]);
+
+  char temp_path[strlen(path) + 5];
+  snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+  FILE *file = fopen(temp_path, "wb");
+  if (!file) {
+    fprintf(stderr, "error: could not open %s\n", temp_path);
+    perror("fopen");
+    free(plies);
+    free(changes);
+    return false;
+  }
+
+  bool success = fwrite(header, sizeof(header), 1, file) == 1;
+  for (size_t i = 0; success && i < MOVE_CACHE_SIZE; i++) {
+    if (cache->entries[i].key)
+      success = fwrite(&cache->entries[i], sizeof(move_cache_entry), 1,
+                       file) == 1;
+  }
+  success = success &&
+            fwrite(plies, sizeof(session_ply), history->length, file) ==
+                history->length &&
+            fwrite(changes, sizeof(session_change), change_count, file) ==
+                change_count &&
+            fputs(start_fen, file) >= 0 && fputs(end_fen, file) >= 0;
+
+  // The data must be on the disk before the old session is replaced.
+  success = success && fflush(file) == 0 && fsync(fileno(file)) == 0;
+
+  free(plies);
+  free(changes);
+
+  if (fclose(file) || !success || rename(temp_path, path) < 0) {
+    fprintf(stderr, "error: could not write %s\n", path);
+    unlink(temp_path);
+    return false;
+  }
+  return true;
+}
+
+static bool restore(const char *map, size_t map_size, history *history,
+                    move_cache *cache, session_settings *settings) {
+  if (map_size < SESSION_HEADER_SIZE || memcmp(map, SESSION_MAGIC, 4) ||
+      get_u32(map + 4) != SESSION_VERSION)
+    return false;
+
+  size_t ply_count = get_u32(map + 8);
+  size_t cursor = get_u32(map + 12);
+  size_t change_count = get_u32(map + 16);
+  size_t cache_count = get_u32(map + 20);
+  size_t start_fen_length = get_u16(map + 24);
+  size_t end_fen_length = get_u16(map + 26);
+
+  if (cursor > ply_count || start_fen_length >= 128 ||
+      end_fen_length >= 128 ||
+      map_size != SESSION_HEADER_SIZE +
+                      cache_count * sizeof(move_cache_entry) +
+                      ply_count * sizeof(session_ply) +
+                      change_count * sizeof(session_change) +
+                      start_fen_length + end_fen_length)
+    return false;
+
+  const move_cache_entry *entries =
+      (const move_cache_entry *)(map + SESSION_HEADER_SIZE);
+  const session_ply *plies = (const session_ply *)(entries + cache_count);
+  const session_change *changes = (const session_change *)(plies + ply_count);
+  const char *fens = (const char *)(changes + change_count);
+
+  char start_fen[128], end_fen[128];
+  memcpy(start_fen, fens, start_fen_length);
+  start_fen[start_fen_length] = '\0';
+  memcpy(end_fen, fens + start_fen_length, end_fen_length);
+  end_fen[end_fen_length] = '\0';
+
+  char board[64];
+  bool turn;
+  if (!load_fen(start_fen, board, &turn) ||
+      !history_init(history, board, turn, (uint8_t)map[31]))
+    return false;
+
+  // Replay the changes of every move, the engine is not needed for this.
+  size_t change = 0;
+  for (size_t ply = 0; ply < ply_count; ply++) {
+    move move;
+    if (change + plies[ply].change_count > change_count ||
+        !record_unpack_move(plies[ply].words, 2, &move)) {
+      history_free(history);
+      return false;
+    }
+
+    for (int i = 0; i < plies[ply].change_count; i++, change++) {
+      if (changes[change].position >= 64) {
+        history_free(history);
+        return false;
+      }
+      board[changes[change].position] = changes[change].after;
+    }
+
+    if (!history_push(history, move, board, plies[ply].turn,
+                      plies[ply].status)) {
+      history_free(history);
+      return false;
+    }
+  }
+
+  char replayed_fen[128];
+  get_fen_string(replayed_fen, board, history->turn);
+  if (strcmp(replayed_fen, end_fen)) {
+    history_free(history);
+    return false;
+  }
+  history_go(history, cursor);
+
+  for (size_t i = 0; i < cache_count; i++)
+    cache->entries[entries[i].key & (MOVE_CACHE_SIZE - 1)] = entries[i];
+
+  uint8_t engine_plays = map[28];
+  settings->engine_plays[0] = engine_plays & 1;
+  settings->engine_plays[1] = engine_plays >> 1 & 1;
+  settings->analysing = map[29];
+  settings->lost_on_time = map[30];
+  settings->remaining_ms[0] = get_i64(map + 32);
+  settings->remaining_ms[1] = get_i64(map + 40);
+  return true;
+}
+
+bool session_load(const char *path, history *history, move_cache *cache,
+                  session_settings *settings, bool *found) {
+  *found = false;
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    if (errno == ENOENT)
+      return true;
+    fprintf(stderr, "error: could not open %s\n", path);
+    perror("open");
+    return false;
+  }
+  *found = true;
+
+  struct stat stat;
+  if (fstat(fd, &stat) < 0 || stat.st_size < SESSION_HEADER_SIZE) {
+    fprintf(stderr, "error: %s is not a session\n", path);
+    close(fd);
+    return false;
+  }
+
+  void *map = mmap(NULL, stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "error: could not map %s\n", path);
+    perror("mmap");
+    return false;
+  }
+
+  bool success = restore(map, stat.st_size, history, cache, settings);
+  munmap(map, stat.st_size);
+
+  if (!success)
+    fprintf(stderr, "error: %s is not a session\n", path);
+  return success;
+}
@@ -0,0 +1,51 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include "history.h"
+#include "movecache.h"
+
+#include <stdbool.h>
+
+// A session file is a header followed by the move cache entries, the moves,
+// the squares they changed and the starting and final FEN strings, in the byte
+// order of the machine. Moves are packed as in game archives.
+#define SESSION_MAGIC "JISS"
+#define SESSION_VERSION 1
+#define SESSION_HEADER_SIZE 48
+
+// What is restored besides the game.
+typedef struct {
+  bool engine_plays[2];
+  bool analysing;
+  bool lost_on_time;
+  long remaining_ms[2];
+} session_settings;
+
+// Write the session atomically, replacing the file at path only once the new
+// one is complete. The cursor of the history is kept.
+bool session_save(const char *path, history *history, const move_cache *cache,
+                  const session_settings *settings);
+
+// Map a session file and restore it into an uninitialized history. The cache
+// is only overwritten if the session is loaded. Sets found to false and
+// succeeds if there is no file at path.
+bool session_load(const char *path, history *history, move_cache *cache,
+                  session_settings *settings, bool *found);
+
+#endif
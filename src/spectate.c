@@ -0,0 +1,84 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "spectate.h"
+#include "broadcast.h"
+#include "gui.h"
+#include "position.h"
+#include "timing.h"
+
+#include <raylib.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+bool spectate(const char *path, assets *assets) {
+  broadcast_view view;
+  if (!broadcast_connect(&view, path))
+    return false;
+
+  move no_moves[4] = {
+      {POSITION_INV},
+      {POSITION_INV},
+      {POSITION_INV},
+      {POSITION_INV},
+  };
+  gui_input input = {0};
+
+  uint64_t anim_start_ms = 0;
+  int frame_rate = 0;
+
+  bool success = true;
+  while (!WindowShouldClose()) {
+    bool moved;
+    if (!broadcast_receive(&view, &moved)) {
+      fprintf(stderr, "error: the broadcast of %s ended\n", path);
+      success = false;
+      break;
+    }
+    if (moved)
+      anim_start_ms = timing_now_ms();
+
+    float anim_progress = 1;
+    if (anim_start_ms)
+      anim_progress = (float)(timing_now_ms() - anim_start_ms) / MOVE_ANIM_MS;
+
+    BeginDrawing();
+    ClearBackground(BACKGROUND_COLOR);
+
+    if (view.synced) {
+      gui_draw_board(assets, view.board, view.last_move, POSITION_INV,
+                     no_moves, anim_progress, &input);
+      gui_draw_status(view.status, view.turn, view.lost_on_time);
+    } else {
+      DrawText("Waiting for the game", 900, 50, 30, WHITE);
+    }
+
+    // Nothing happens between moves, which arrive within an idle frame.
+    int target_frame_rate =
+        anim_progress < 1 ? gui_refresh_rate() : IDLE_FRAME_RATE;
+    if (target_frame_rate != frame_rate) {
+      SetTargetFPS(target_frame_rate);
+      frame_rate = target_frame_rate;
+    }
+
+    EndDrawing();
+  }
+
+  broadcast_disconnect(&view);
+  return success;
+}
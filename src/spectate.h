@@ -0,0 +1,28 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPECTATE_H
+#define SPECTATE_H
+
+#include "gui.h"
+
+#include <stdbool.h>
+
+// Show the game broadcast on the Unix socket at path in the window, without
+// any input, until the window is closed or the broadcast ends.
+bool spectate(const char *path, assets *assets);
+
+#endif
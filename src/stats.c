@@ -0,0 +1,261 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "stats.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Durations are counted in buckets of a quarter of a power of two, which is
+// enough to tell the percentiles apart while staying lock free.
+#define HISTOGRAM_BUCKETS 252
+
+typedef struct {
+  _Atomic uint64_t buckets[HISTOGRAM_BUCKETS];
+  _Atomic uint64_t max_ns;
+} histogram;
+
+static const char *COMMAND_NAMES[STATS_COMMAND_COUNT] = {
+    [STATS_SAVEFEN] = "savefen",   [STATS_LOADFEN] = "loadfen",
+    [STATS_STATUS] = "status",     [STATS_MAKEMOVE] = "makemove",
+    [STATS_DESCMOVE] = "descmove", [STATS_ALLMOVES] = "allmoves",
+    [STATS_EVALUATE] = "evaluate", [STATS_OTHER] = "other",
+};
+
+static struct {
+  _Atomic uint64_t commands[STATS_COMMAND_COUNT];
+  _Atomic uint64_t bytes_sent;
+  _Atomic uint64_t bytes_received;
+  _Atomic int64_t pending;
+  _Atomic int engine_pid;
+  _Atomic uint64_t spawned;
+  _Atomic uint64_t killed;
+  histogram round_trips;
+  histogram frames;
+} stats;
+
+static int server_fd = -1;
+static pthread_t server_thread;
+static struct sockaddr_un server_address;
+
+static int bucket_of(uint64_t ns) {
+  if (ns < 4)
+    return ns;
+  int exponent = 63 - __builtin_clzll(ns);
+  return (exponent - 1) * 4 + (ns >> (exponent - 2) & 3);
+}
+
+// The largest duration counted in a bucket.
+static uint64_t bucket_limit(int bucket) {
+  if (bucket < 4)
+    return bucket;
+  int exponent = bucket / 4 + 1;
+  return ((uint64_t)(4 + bucket % 4 + 1) << (exponent - 2)) - 1;
+}
+
+static void histogram_add(histogram *histogram, uint64_t ns) {
+  atomic_fetch_add_explicit(&histogram->buckets[bucket_of(ns)], 1,
+                            memory_order_relaxed);
+
+  uint64_t max =
+      atomic_load_explicit(&histogram->max_ns, memory_order_relaxed);
+  while (ns > max && !atomic_compare_exchange_weak_explicit(
+                         &histogram->max_ns, &max, ns, memory_order_relaxed,
+                         memory_order_relaxed))
+    ;
+}
+
+void stats_count_command(const char *command, size_t bytes) {
+  stats_command type = STATS_OTHER;
+  size_t length = strcspn(command, " \n");
+  for (int i = 0; i < STATS_OTHER; i++) {
+    if (strlen(COMMAND_NAMES[i]) == length &&
+        !strncmp(command, COMMAND_NAMES[i], length))
+      type = i;
+  }
+
+  atomic_fetch_add_explicit(&stats.commands[type], 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&stats.bytes_sent, bytes, memory_order_relaxed);
+}
+
+void stats_count_reply(size_t bytes) {
+  atomic_fetch_add_explicit(&stats.bytes_received, bytes,
+                            memory_order_relaxed);
+}
+
+void stats_record_round_trip(uint64_t ns) {
+  histogram_add(&stats.round_trips, ns);
+}
+
+void stats_record_frame(uint64_t ns) { histogram_add(&stats.frames, ns); }
+
+void stats_add_pending(int count) {
+  atomic_fetch_add_explicit(&stats.pending, count, memory_order_relaxed);
+}
+
+void stats_count_spawn(int pid) {
+  // The first engine is the one playing the game.
+  int none = 0;
+  atomic_compare_exchange_strong(&stats.engine_pid, &none, pid);
+  atomic_fetch_add_explicit(&stats.spawned, 1, memory_order_relaxed);
+}
+
+void stats_count_kill() {
+  atomic_fetch_add_explicit(&stats.killed, 1, memory_order_relaxed);
+}
+
+// Take the counts of a histogram and write its percentiles.
+static size_t format_histogram(char *text, size_t size, const char *name,
+                               histogram *histogram) {
+  static const double fractions[] = {0.5, 0.9, 0.99};
+  static const char *labels[] = {"p50", "p90", "p99"};
+
+  uint64_t buckets[HISTOGRAM_BUCKETS];
+  uint64_t count = 0;
+  for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    buckets[i] =
+        atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+    count += buckets[i];
+  }
+
+  size_t length = snprintf(text, size, "%s_count %" PRIu64 "\n", name, count);
+  for (int i = 0; i < 3 && length < size; i++) {
+    uint64_t rank = fractions[i] * count, seen = 0;
+    int bucket = 0;
+    while (count && bucket < HISTOGRAM_BUCKETS - 1 &&
+           (seen += buckets[bucket]) <= rank)
+      bucket++;
+
+    length += snprintf(text + length, size - length, "%s_%s_us %.1f\n", name,
+                       labels[i], count ? bucket_limit(bucket) / 1e3 : 0);
+  }
+
+  if (length < size)
+    length += snprintf(
+        text + length, size - length, "%s_max_us %.1f\n", name,
+        atomic_load_explicit(&histogram->max_ns, memory_order_relaxed) / 1e3);
+  return length < size ? length : size - 1;
+}
+
+static size_t format_stats(char *text, size_t size) {
+  size_t length = snprintf(
+      text, size,
+      "engine_pid %d\nengines_spawned %" PRIu64 "\nengines_killed %" PRIu64
+      "\npending_replies %" PRId64 "\nbytes_sent %" PRIu64
+      "\nbytes_received %" PRIu64 "\n",
+      atomic_load_explicit(&stats.engine_pid, memory_order_relaxed),
+      atomic_load_explicit(&stats.spawned, memory_order_relaxed),
+      atomic_load_explicit(&stats.killed, memory_order_relaxed),
+      atomic_load_explicit(&stats.pending, memory_order_relaxed),
+      atomic_load_explicit(&stats.bytes_sent, memory_order_relaxed),
+      atomic_load_explicit(&stats.bytes_received, memory_order_relaxed));
+
+  for (int i = 0; i < STATS_COMMAND_COUNT && length < size; i++)
+    length += snprintf(
+        text + length, size - length, "commands_%s %" PRIu64 "\n",
+        COMMAND_NAMES[i],
+        atomic_load_explicit(&stats.commands[i], memory_order_relaxed));
+
+  if (length < size)
+    length += format_histogram(text + length, size - length, "round_trip",
+                               &stats.round_trips);
+  if (length < size)
+    length += format_histogram(text + length, size - length, "frame",
+                               &stats.frames);
+  return length < size ? length : size - 1;
+}
+
+static void *serve(void *argument) {
+  for (;;) {
+    int client = accept(server_fd, NULL, NULL);
+    if (client < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      // The socket was shut down.
+      return NULL;
+    }
+
+    char text[4096];
+    size_t length = format_stats(text, sizeof(text));
+
+    // Clients that went away must not kill the GUI with SIGPIPE.
+    send(client, text, length, MSG_NOSIGNAL);
+    close(client);
+  }
+}
+
+bool stats_server_start(const char *path) {
+  if (strlen(path) >= sizeof(server_address.sun_path)) {
+    fprintf(stderr, "error: socket path %s is too long\n", path);
+    return false;
+  }
+
+  server_address.sun_family = AF_UNIX;
+  strcpy(server_address.sun_path, path);
+
+  server_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (server_fd < 0) {
+    fprintf(stderr, "error: could not create a socket\n");
+    perror("socket");
+    return false;
+  }
+
+  // A socket left behind by an earlier run would make bind fail.
+  unlink(path);
+  if (bind(server_fd, (struct sockaddr *)&server_address,
+           sizeof(server_address)) < 0 ||
+      listen(server_fd, 8) < 0) {
+    fprintf(stderr, "error: could not listen on %s\n", path);
+    perror("bind");
+    close(server_fd);
+    server_fd = -1;
+    return false;
+  }
+
+  if (pthread_create(&server_thread, NULL, serve, NULL)) {
+    fprintf(stderr, "error: could not start the statistics server\n");
+    close(server_fd);
+    unlink(path);
+    server_fd = -1;
+    return false;
+  }
+
+  // Stop the thread and remove the socket however the program exits.
+  atexit(stats_server_stop);
+  return true;
+}
+
+void stats_server_stop() {
+  if (server_fd < 0)
+    return;
+
+  // Wake the server from accept.
+  shutdown(server_fd, SHUT_RDWR);
+  pthread_join(server_thread, NULL);
+  close(server_fd);
+  unlink(server_address.sun_path);
+  server_fd = -1;
+}
@@ -0,0 +1,65 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The commands counted separately, others are counted together.
+typedef enum {
+  STATS_SAVEFEN,
+  STATS_LOADFEN,
+  STATS_STATUS,
+  STATS_MAKEMOVE,
+  STATS_DESCMOVE,
+  STATS_ALLMOVES,
+  STATS_EVALUATE,
+  STATS_OTHER,
+  STATS_COMMAND_COUNT,
+} stats_command;
+
+// Statistics are kept in process wide atomic counters, so they can be updated
+// from any thread without locking and read by the server at any time.
+
+// Count a command written to an engine, given as its text.
+void stats_count_command(const char *command, size_t bytes);
+
+// Count the bytes of a reply read from an engine.
+void stats_count_reply(size_t bytes);
+
+// Record the time between sending a command and reading its reply.
+void stats_record_round_trip(uint64_t ns);
+
+// Record the time taken by a frame of the window.
+void stats_record_frame(uint64_t ns);
+
+// Add to the number of replies the engines still owe.
+void stats_add_pending(int count);
+
+void stats_count_spawn(int pid);
+void stats_count_kill();
+
+// Serve the statistics as text lines to every client connecting to a Unix
+// socket at path, from a thread of their own. The server is stopped on exit
+// if it was not before.
+bool stats_server_start(const char *path);
+
+void stats_server_stop();
+
+#endif
@@ -0,0 +1,861 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "tablebase.h"
+#include "fen.h"
+#include "jis_process.h"
+#include "position.h"
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char *PIECE_ORDER = "PNpn";
+
+bool tb_signature(const char *board, char signature[TB_SIGNATURE_SIZE]) {
+  int length = 0;
+  for (const char *piece = PIECE_ORDER; *piece; piece++) {
+    for (int position = 0; position < 64; position++) {
+      if (board[position] != *piece)
+        continue;
+
+      if (length == TB_MAX_PIECES)
+        return false;
+      signature[length++] = *piece;
+    }
+  }
+
+  signature[length] = '\0';
+  return true;
+}
+
+uint64_t tb_entry_count(const char *signature) {
+  uint64_t count = 2;
+  for (; *signature; signature++)
+    count *= 64;
+  return count;
+}
+
+uint64_t tb_index(const char *board, bool turn, const char *signature) {
+  uint64_t index = turn;
+  uint64_t scale = 2;
+
+  // Identical pieces are taken in the order of their squares.
+  int position = 0;
+  for (const char *piece = signature; *piece; piece++) {
+    if (piece == signature || *piece != piece[-1])
+      position = 0;
+    while (board[position] != *piece)
+      position++;
+
+    index += position++ * scale;
+    scale *= 64;
+  }
+  return index;
+}
+
+bool tb_board(uint64_t index, const char *signature, char *board, bool *turn) {
+  memset(board, ' ', 64);
+  *turn = index & 1;
+  index >>= 1;
+
+  int previous_position = POSITION_INV;
+  for (const char *piece = signature; *piece; piece++) {
+    int position = index % 64;
+    index /= 64;
+
+    if (board[position] != ' ' ||
+        (piece != signature && *piece == piece[-1] &&
+         position < previous_position))
+      return false;
+
+    board[position] = *piece;
+    previous_position = position;
+  }
+  return true;
+}
+
+void tablebase_init(tablebase *tablebase, const char *directory) {
+  memset(tablebase, 0, sizeof(*tablebase));
+  tablebase->directory = directory;
+}
+
+void tablebase_free(tablebase *tablebase) {
+  for (size_t i = 0; i < tablebase->file_count; i++) {
+    if (tablebase->files[i].map)
+      munmap(tablebase->files[i].map, tablebase->files[i].map_size);
+  }
+  tablebase->file_count = 0;
+}
+
+static void get_path(const char *directory, const char *signature,
+                     char *path, size_t path_size) {
+  snprintf(path, path_size, "%s/%s.jtb", directory, signature);
+}
+
+// Find the mapped table of a signature, mapping it if this is the first time
+// it is asked for.
+static tablebase_file *get_file(tablebase *tablebase, const char *signature) {
+  for (size_t i = 0; i < tablebase->file_count; i++) {
+    if (!strcmp(tablebase->files[i].signature, signature))
+      return &tablebase->files[i];
+  }
+
+  if (tablebase->file_count == TB_MAX_FILES)
+    return NULL;
+
+  // Missing tables are remembered as well, so they are not looked for again.
+  tablebase_file *file = &tablebase->files[tablebase->file_count++];
+  memset(file, 0, sizeof(*file));
+  strcpy(file->signature, signature);
+
+  char path[4096];
+  get_path(tablebase->directory, signature, path, sizeof(path));
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return file;
+
+  struct stat stat;
+  if (fstat(fd, &stat) < 0 || stat.st_size < TB_HEADER_SIZE) {
+    close(fd);
+    return file;
+  }
+
+  void *map = mmap(NULL, stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return file;
+
+  const char *header = map;
+  uint64_t entry_count = tb_entry_count(signature);
+  uint32_t version;
+  uint64_t header_entry_count;
+  memcpy(&version, header + 4, sizeof(version));
+  memcpy(&header_entry_count, header + 24, sizeof(header_entry_count));
+  if (memcmp(header, TB_MAGIC, 4) || version != TB_VERSION ||
+      strncmp(header + 8, signature, TB_SIGNATURE_SIZE) ||
+      header_entry_count != entry_count ||
+      stat.st_size != TB_HEADER_SIZE + entry_count * (sizeof(uint16_t) + 1)) {
+    fprintf(stderr, "error: %s is not a valid table\n", path);
+    munmap(map, stat.st_size);
+    return file;
+  }
+
+  file->map = map;
+  file->map_size = stat.st_size;
+  file->values = (const uint16_t *)(header + TB_HEADER_SIZE);
+  file->best_moves = (const uint8_t *)(file->values + entry_count);
+  file->entry_count = entry_count;
+  return file;
+}
+
+// Find the table of a board and the index of the board in it, or NULL.
+static tablebase_file *find_entry(tablebase *tablebase, const char *board,
+                                  bool turn, uint64_t *index) {
+  char signature[TB_SIGNATURE_SIZE];
+  if (!tablebase->directory || !tb_signature(board, signature))
+    return NULL;
+
+  tablebase_file *file = get_file(tablebase, signature);
+  if (!file || !file->map)
+    return NULL;
+
+  *index = tb_index(board, turn, signature);
+  return file;
+}
+
+uint16_t tablebase_probe(tablebase *tablebase, const char *board, bool turn) {
+  uint64_t index;
+  tablebase_file *file = find_entry(tablebase, board, turn, &index);
+  return file ? file->values[index] : TB_INVALID;
+}
+
+// The value of a finished game for the side to move.
+static uint16_t finished_value(int status, bool turn) {
+  switch (status >> 4) {
+  case 1:
+    return TB_DRAW;
+  case 2:
+    return turn ? TB_WIN : TB_LOSS;
+  case 3:
+    return turn ? TB_LOSS : TB_WIN;
+  default:
+    return TB_INVALID;
+  }
+}
+
+// How good a move is for the side making it, given the value of the resulting
+// position. Wins are better the sooner they come, losses the later.
+static long move_score(uint16_t value) {
+  switch (TB_RESULT(value)) {
+  case TB_LOSS:
+    return 0x10000 - TB_DISTANCE(value);
+  case TB_WIN:
+    return -0x10000 + TB_DISTANCE(value);
+  default:
+    return 0;
+  }
+}
+
+bool tablebase_best_move(tablebase *tablebase, jis_process *process,
+                         char *board, bool turn, move *result) {
+  // Do not bother the process unless the position is in the tables.
+  uint64_t index;
+  tablebase_file *file = find_entry(tablebase, board, turn, &index);
+  if (!file || file->values[index] == TB_INVALID ||
+      file->best_moves[index] == TB_NO_MOVE)
+    return false;
+
+  move moves[64];
+  int move_count = jis_ask_all_moves(process, board, turn, moves, 64);
+  if (move_count <= file->best_moves[index])
+    return false;
+
+  *result = moves[file->best_moves[index]];
+  return true;
+}
+
+// A successor is either a position of the table being generated, or has a
+// fixed value because the game ended or it belongs to another table.
+#define SUCCESSOR_SELF 0
+#define SUCCESSOR_FIXED 1
+#define SUCCESSOR_FOREIGN 2
+
+typedef struct {
+  uint32_t index;
+  uint16_t value;
+  // SUCCESSOR_FOREIGN plus the index of the foreign signature for positions
+  // of other tables.
+  uint8_t table;
+} tb_successor;
+
+typedef struct generator generator;
+
+// Positions whose moves and successors are asked for in one batch each. The
+// commands of their successors fit in a batch, with at most 4 moves a piece.
+#define TB_BATCH_POSITIONS 32
+#define TB_MAX_MOVES (4 * TB_MAX_PIECES)
+
+typedef struct {
+  uint64_t index;
+  char board[64];
+  bool turn;
+  char fen[128];
+
+  char moves[TB_MAX_MOVES][5];
+  int move_count;
+} tb_position;
+
+typedef struct {
+  generator *generator;
+  uint64_t begin;
+  uint64_t end;
+
+  jis_process process;
+  jis_batch batch;
+  char replies[JIS_BATCH_SIZE];
+
+  tb_successor *successors;
+  size_t successor_count;
+  size_t successor_capacity;
+
+  bool success;
+  uint64_t changed;
+} tb_worker;
+
+struct generator {
+  const char *directory;
+  const char *executable;
+  const char *signature;
+  uint64_t entry_count;
+
+  uint16_t *values;
+  uint16_t *next_values;
+  uint32_t *first_successor;
+  uint8_t *successor_count;
+  uint8_t *best_moves;
+
+  tb_worker *workers;
+  int worker_count;
+
+  // The signatures of the other tables successors belong to.
+  char foreign[TB_MAX_FILES][TB_SIGNATURE_SIZE];
+  size_t foreign_count;
+  pthread_mutex_t foreign_mutex;
+
+  // The distance being solved.
+  int distance;
+};
+
+static int foreign_id(generator *generator, const char *signature) {
+  pthread_mutex_lock(&generator->foreign_mutex);
+
+  size_t id = 0;
+  while (id < generator->foreign_count &&
+         strcmp(generator->foreign[id], signature))
+    id++;
+
+  if (id == generator->foreign_count) {
+    if (id == TB_MAX_FILES) {
+      pthread_mutex_unlock(&generator->foreign_mutex);
+      return -1;
+    }
+    strcpy(generator->foreign[generator->foreign_count++], signature);
+  }
+
+  pthread_mutex_unlock(&generator->foreign_mutex);
+  return id;
+}
+
+static bool add_successor(tb_worker *worker, tb_successor successor) {
+  if (worker->successor_count == worker->successor_capacity) {
+    size_t capacity =
+        worker->successor_capacity ? worker->successor_capacity * 2 : 4096;
+    tb_successor *successors =
+        realloc(worker->successors, capacity * sizeof(tb_successor));
+    if (!successors) {
+      fprintf(stderr, "error: realloc failed\n");
+      perror("realloc");
+      return false;
+    }
+    worker->successors = successors;
+    worker->successor_capacity = capacity;
+  }
+
+  worker->successors[worker->successor_count++] = successor;
+  return true;
+}
+
+// Parse the reply to "allmoves", "{ a2a3 a2b3 }", adding the moves.
+static bool parse_moves(char *reply, tb_position *position) {
+  if (strncmp(reply, "{ ", 2))
+    return false;
+
+  char *state;
+  for (char *word = strtok_r(reply + 2, " ", &state); word && strcmp(word, "}");
+       word = strtok_r(NULL, " ", &state)) {
+    if (strlen(word) != 4 || position->move_count == TB_MAX_MOVES)
+      return false;
+    strcpy(position->moves[position->move_count++], word);
+  }
+  return true;
+}
+
+// Ask the engine for the status and the moves of the positions, then for the
+// position and the status after every move. Both take a single round trip.
+static bool enumerate_batch(tb_worker *worker, tb_position *positions,
+                            int count) {
+  generator *generator = worker->generator;
+  jis_process *process = &worker->process;
+  jis_batch *batch = &worker->batch;
+
+  for (int i = 0; i < count; i++) {
+    tb_position *position = &positions[i];
+    get_fen_string(position->fen, position->board, position->turn);
+    if (!jis_batch_add(process, batch, false, "loadfen %s\n", position->fen) ||
+        !jis_batch_add(process, batch, true, "status -i\n"))
+      return false;
+
+    // White pieces are uppercase.
+    for (int square = 0; square < 64; square++) {
+      char name[3];
+      get_position_str(square, name);
+      if (position->board[square] != ' ' &&
+          !isupper(position->board[square]) == !position->turn &&
+          !jis_batch_add(process, batch, true, "allmoves %s\n", name))
+        return false;
+    }
+  }
+
+  if (!jis_batch_run(process, batch, worker->replies, sizeof(worker->replies)))
+    return false;
+
+  char *reply = worker->replies;
+  for (int i = 0; i < count; i++) {
+    tb_position *position = &positions[i];
+    int status = strtol(reply, NULL, 10);
+    reply += strlen(reply) + 1;
+
+    position->move_count = 0;
+    for (int square = 0; square < 64; square++) {
+      if (position->board[square] == ' ' ||
+          !isupper(position->board[square]) != !position->turn)
+        continue;
+
+      char *next = reply + strlen(reply) + 1;
+      if (!parse_moves(reply, position)) {
+        fprintf(stderr, "error: invalid moves list from %s\n",
+                process->child_executable);
+        return false;
+      }
+      reply = next;
+    }
+
+    // Treat a player that can not move but has not lost as a draw.
+    if (status >> 4) {
+      generator->values[position->index] =
+          finished_value(status, position->turn);
+      position->move_count = 0;
+    } else if (!position->move_count) {
+      generator->values[position->index] = TB_DRAW;
+    }
+
+    for (int j = 0; j < position->move_count; j++) {
+      if (!jis_batch_add(process, batch, false, "loadfen %s\n",
+                         position->fen) ||
+          !jis_batch_add(process, batch, false, "makemove %s\n",
+                         position->moves[j]) ||
+          !jis_batch_add(process, batch, true, "savefen\n") ||
+          !jis_batch_add(process, batch, true, "status -i\n"))
+        return false;
+    }
+  }
+
+  if (!jis_batch_run(process, batch, worker->replies, sizeof(worker->replies)))
+    return false;
+
+  reply = worker->replies;
+  for (int i = 0; i < count; i++) {
+    tb_position *position = &positions[i];
+    if (!position->move_count)
+      continue;
+
+    generator->first_successor[position->index] = worker->successor_count;
+    generator->successor_count[position->index] = position->move_count;
+
+    for (int j = 0; j < position->move_count; j++) {
+      char next_board[64];
+      bool next_turn;
+      bool loaded = load_fen(reply, next_board, &next_turn);
+      reply += strlen(reply) + 1;
+      int next_status = strtol(reply, NULL, 10);
+      reply += strlen(reply) + 1;
+
+      tb_successor successor = {.table = SUCCESSOR_FIXED};
+      char signature[TB_SIGNATURE_SIZE];
+
+      if (!loaded) {
+        fprintf(stderr, "error: invalid position from %s\n",
+                process->child_executable);
+        return false;
+
+      } else if (next_status >> 4) {
+        successor.value = finished_value(next_status, next_turn);
+
+      } else if (!tb_signature(next_board, signature)) {
+        fprintf(stderr, "error: %s resulted in too many pieces\n",
+                position->moves[j]);
+        return false;
+
+      } else {
+        successor.index = tb_index(next_board, next_turn, signature);
+
+        if (!strcmp(signature, generator->signature)) {
+          successor.table = SUCCESSOR_SELF;
+        } else {
+          int id = foreign_id(generator, signature);
+          if (id < 0) {
+            fprintf(stderr, "error: too many tables\n");
+            return false;
+          }
+          successor.table = SUCCESSOR_FOREIGN + id;
+        }
+      }
+
+      if (!add_successor(worker, successor))
+        return false;
+    }
+  }
+
+  return true;
+}
+
+// Enumerate the positions in the range of the worker, a batch at a time.
+static void *enumerate_worker(void *argument) {
+  tb_worker *worker = argument;
+  generator *generator = worker->generator;
+
+  tb_position positions[TB_BATCH_POSITIONS];
+  int count = 0;
+
+  for (uint64_t index = worker->begin; index < worker->end; index++) {
+    tb_position *position = &positions[count];
+    if (!tb_board(index, generator->signature, position->board,
+                  &position->turn))
+      continue;
+
+    position->index = index;
+    if (++count == TB_BATCH_POSITIONS) {
+      if (!enumerate_batch(worker, positions, count))
+        return NULL;
+      count = 0;
+    }
+  }
+
+  if (count && !enumerate_batch(worker, positions, count))
+    return NULL;
+
+  worker->success = true;
+  return NULL;
+}
+
+// Resolve the positions whose game ends in exactly the current distance.
+static void *solve_worker(void *argument) {
+  tb_worker *worker = argument;
+  generator *generator = worker->generator;
+  int distance = generator->distance;
+  worker->changed = 0;
+
+  for (uint64_t index = worker->begin; index < worker->end; index++) {
+    uint16_t value = generator->values[index];
+    generator->next_values[index] = value;
+
+    if (value != TB_INVALID || !generator->successor_count[index])
+      continue;
+
+    bool all_win = true;
+    int shortest_loss = -1;
+    int longest_win = 0;
+
+    tb_successor *successors =
+        worker->successors + generator->first_successor[index];
+    for (int i = 0; i < generator->successor_count[index]; i++) {
+      uint16_t successor_value = successors[i].table == SUCCESSOR_SELF
+                                     ? generator->values[successors[i].index]
+                                     : successors[i].value;
+      int successor_distance = TB_DISTANCE(successor_value);
+
+      switch (TB_RESULT(successor_value)) {
+      case TB_LOSS:
+        all_win = false;
+        if (shortest_loss < 0 || successor_distance < shortest_loss)
+          shortest_loss = successor_distance;
+        break;
+      case TB_WIN:
+        if (successor_distance > longest_win)
+          longest_win = successor_distance;
+        break;
+      default:
+        all_win = false;
+        break;
+      }
+    }
+
+    if (shortest_loss == distance - 1)
+      generator->next_values[index] = TB_WIN | distance;
+    else if (all_win && longest_win == distance - 1)
+      generator->next_values[index] = TB_LOSS | distance;
+    else
+      continue;
+
+    worker->changed++;
+  }
+
+  return NULL;
+}
+
+// Find the best move of every position, the first of the moves with the best
+// score for the side making it.
+static void *best_move_worker(void *argument) {
+  tb_worker *worker = argument;
+  generator *generator = worker->generator;
+
+  for (uint64_t index = worker->begin; index < worker->end; index++) {
+    generator->best_moves[index] = TB_NO_MOVE;
+
+    long best_score = 0;
+    tb_successor *successors =
+        worker->successors + generator->first_successor[index];
+    for (int i = 0; i < generator->successor_count[index]; i++) {
+      long score = move_score(successors[i].table == SUCCESSOR_SELF
+                                  ? generator->values[successors[i].index]
+                                  : successors[i].value);
+      if (i == 0 || score > best_score) {
+        best_score = score;
+        generator->best_moves[index] = i;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+static bool run_workers(generator *generator, void *(*function)(void *)) {
+  pthread_t threads[generator->worker_count];
+  for (int i = 0; i < generator->worker_count; i++) {
+    if (pthread_create(&threads[i], NULL, function, &generator->workers[i])) {
+      fprintf(stderr, "error: pthread_create failed\n");
+      for (int j = 0; j < i; j++)
+        pthread_join(threads[j], NULL);
+      return false;
+    }
+  }
+
+  for (int i = 0; i < generator->worker_count; i++)
+    pthread_join(threads[i], NULL);
+  return true;
+}
+
+static bool write_table(generator *generator) {
+  char path[4096];
+  get_path(generator->directory, generator->signature, path, sizeof(path));
+
+  char temp_path[sizeof(path) + 8];
+  snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+  FILE *file = fopen(temp_path, "wb");
+  if (!file) {
+    fprintf(stderr, "error: could not open %s\n", temp_path);
+    perror("fopen");
+    return false;
+  }
+
+  // The numbers are copied, as the header is a char array with no alignment.
+  char header[TB_HEADER_SIZE] = {0};
+  uint32_t version = TB_VERSION;
+  uint32_t signature_length = strlen(generator->signature);
+  memcpy(header, TB_MAGIC, 4);
+  memcpy(header + 4, &version, sizeof(version));
+  strncpy(header + 8, generator->signature, TB_SIGNATURE_SIZE);
+  memcpy(header + 16, &signature_length, sizeof(signature_length));
+  memcpy(header + 24, &generator->entry_count, sizeof(uint64_t));
+
+  bool success = fwrite(header, sizeof(header), 1, file) == 1 &&
+                 fwrite(generator->values, sizeof(uint16_t),
+                        generator->entry_count,
+                        file) == generator->entry_count &&
+                 fwrite(generator->best_moves, 1, generator->entry_count,
+                        file) == generator->entry_count;
+
+  if (fclose(file) || !success || rename(temp_path, path) < 0) {
+    fprintf(stderr, "error: could not write %s\n", path);
+    unlink(temp_path);
+    return false;
+  }
+  return true;
+}
+
+static bool valid_signature(const char *signature) {
+  size_t length = strlen(signature);
+  if (!length || length > TB_MAX_PIECES)
+    return false;
+
+  // The pieces must follow the piece order.
+  const char *order = PIECE_ORDER;
+  for (; *signature; signature++) {
+    while (*order && *order != *signature)
+      order++;
+    if (!*order)
+      return false;
+  }
+  return true;
+}
+
+static bool generate(const char *directory, const char *signature,
+                     const char *executable, int thread_count, int depth);
+
+// Enumerate, then get the values of the foreign successors.
+static bool enumerate(generator *generator, int depth) {
+  for (int i = 0; i < generator->worker_count; i++) {
+    tb_worker *worker = &generator->workers[i];
+    worker->process.child_executable = generator->executable;
+    if (!jis_create_proc(&worker->process)) {
+      for (int j = 0; j < i; j++)
+        jis_kill_proc(&generator->workers[j].process);
+      return false;
+    }
+  }
+
+  bool success = run_workers(generator, enumerate_worker);
+  for (int i = 0; i < generator->worker_count; i++) {
+    jis_kill_proc(&generator->workers[i].process);
+    success = success && generator->workers[i].success;
+  }
+  if (!success)
+    return false;
+
+  // Generate the missing tables the successors belong to.
+  tablebase tablebase;
+  tablebase_init(&tablebase, generator->directory);
+
+  for (size_t id = 0; id < generator->foreign_count; id++) {
+    tablebase_file *file = get_file(&tablebase, generator->foreign[id]);
+    if (file && file->map)
+      continue;
+
+    tablebase_free(&tablebase);
+    if (!generate(generator->directory, generator->foreign[id],
+                  generator->executable, generator->worker_count, depth + 1))
+      return false;
+    tablebase_init(&tablebase, generator->directory);
+  }
+
+  // Their values are fixed from now on.
+  for (int i = 0; i < generator->worker_count; i++) {
+    tb_worker *worker = &generator->workers[i];
+    for (size_t j = 0; j < worker->successor_count; j++) {
+      tb_successor *successor = &worker->successors[j];
+      if (successor->table < SUCCESSOR_FOREIGN)
+        continue;
+
+      tablebase_file *file = get_file(
+          &tablebase, generator->foreign[successor->table - SUCCESSOR_FOREIGN]);
+      if (!file || !file->map) {
+        fprintf(stderr, "error: could not load the table %s\n",
+                generator->foreign[successor->table - SUCCESSOR_FOREIGN]);
+        tablebase_free(&tablebase);
+        return false;
+      }
+
+      successor->value = file->values[successor->index];
+      successor->table = SUCCESSOR_FIXED;
+    }
+  }
+
+  tablebase_free(&tablebase);
+  return true;
+}
+
+// Solve the positions distance by distance. A position is solved exactly at
+// its distance, so the first value found is the shortest win or longest loss.
+static bool solve(generator *generator) {
+  int longest_fixed = 0;
+  for (int i = 0; i < generator->worker_count; i++) {
+    tb_worker *worker = &generator->workers[i];
+    for (size_t j = 0; j < worker->successor_count; j++) {
+      int distance = TB_DISTANCE(worker->successors[j].value);
+      if (distance > longest_fixed)
+        longest_fixed = distance;
+    }
+  }
+
+  for (generator->distance = 1;; generator->distance++) {
+    if (generator->distance > 0x3fff) {
+      fprintf(stderr, "error: distance out of range\n");
+      return false;
+    }
+
+    if (!run_workers(generator, solve_worker))
+      return false;
+
+    uint16_t *values = generator->values;
+    generator->values = generator->next_values;
+    generator->next_values = values;
+
+    uint64_t changed = 0;
+    for (int i = 0; i < generator->worker_count; i++)
+      changed += generator->workers[i].changed;
+
+    // Positions of the table can only lead to others of the next distance,
+    // fixed values can lead to any distance up to the longest of them.
+    if (!changed && generator->distance > longest_fixed)
+      break;
+  }
+
+  // Positions that neither side can force are draws.
+  for (uint64_t index = 0; index < generator->entry_count; index++) {
+    if (generator->values[index] == TB_INVALID &&
+        generator->successor_count[index])
+      generator->values[index] = TB_DRAW;
+  }
+
+  return run_workers(generator, best_move_worker);
+}
+
+static bool generate(const char *directory, const char *signature,
+                     const char *executable, int thread_count, int depth) {
+  if (!valid_signature(signature)) {
+    fprintf(stderr, "error: invalid signature %s\n", signature);
+    return false;
+  }
+
+  // Material never comes back, so a cycle means something is wrong.
+  if (depth > 2 * TB_MAX_PIECES) {
+    fprintf(stderr, "error: tables depend on each other\n");
+    return false;
+  }
+
+  printf("generating %s\n", signature);
+
+  generator generator = {.directory = directory,
+                         .executable = executable,
+                         .signature = signature,
+                         .entry_count = tb_entry_count(signature),
+                         .worker_count = thread_count};
+  pthread_mutex_init(&generator.foreign_mutex, NULL);
+
+  generator.values = calloc(generator.entry_count, sizeof(uint16_t));
+  generator.next_values = calloc(generator.entry_count, sizeof(uint16_t));
+  generator.first_successor = calloc(generator.entry_count, sizeof(uint32_t));
+  generator.successor_count = calloc(generator.entry_count, sizeof(uint8_t));
+  generator.best_moves = calloc(generator.entry_count, sizeof(uint8_t));
+  generator.workers = calloc(thread_count, sizeof(tb_worker));
+
+  bool success = generator.values && generator.next_values &&
+                 generator.first_successor && generator.successor_count &&
+                 generator.best_moves && generator.workers;
+  if (!success) {
+    fprintf(stderr, "error: calloc failed\n");
+    perror("calloc");
+  }
+
+  if (success) {
+    for (int i = 0; i < thread_count; i++) {
+      generator.workers[i].generator = &generator;
+      generator.workers[i].begin = generator.entry_count * i / thread_count;
+      generator.workers[i].end = generator.entry_count * (i + 1) / thread_count;
+    }
+
+    success = enumerate(&generator, depth) && solve(&generator) &&
+              write_table(&generator);
+  }
+
+  if (success) {
+    uint64_t counts[4] = {0};
+    for (uint64_t index = 0; index < generator.entry_count; index++)
+      counts[generator.values[index] >> 14]++;
+    printf("%s: %" PRIu64 " wins, %" PRIu64 " draws, %" PRIu64
+           " losses, %d plies at most\n",
+           signature, counts[TB_WIN >> 14], counts[TB_DRAW >> 14],
+           counts[TB_LOSS >> 14], generator.distance - 1);
+  }
+
+  for (int i = 0; generator.workers && i < thread_count; i++)
+    free(generator.workers[i].successors);
+  free(generator.workers);
+  free(generator.values);
+  free(generator.next_values);
+  free(generator.first_successor);
+  free(generator.successor_count);
+  free(generator.best_moves);
+  pthread_mutex_destroy(&generator.foreign_mutex);
+  return success;
+}
+
+bool tablebase_generate(const char *directory, const char *signature,
+                        const char *executable, int thread_count) {
+  return generate(directory, signature, executable,
+                  thread_count < 1 ? 1 : thread_count, 0);
+}
@@ -0,0 +1,108 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include "jis_process.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A table holds every position with a given set of pieces, called its
+// signature. The signature lists the pieces in the order P, N, p, n, so a pawn
+// and a knight against a pawn is "PNp".
+#define TB_MAX_PIECES 4
+#define TB_SIGNATURE_SIZE 8
+#define TB_MAX_FILES 64
+
+// Positions are indexed by the side to move and the squares of the pieces in
+// the order of the signature:
+//
+//   turn + 2 * (square_0 + 64 * square_1 + 64^2 * square_2 + ...)
+//
+// Identical pieces must be on increasing squares, other orders are invalid.
+//
+// Every entry is 16 bits, the result for the side to move in the highest two
+// bits and the number of plies until the game ends in the rest.
+#define TB_INVALID 0
+#define TB_DRAW (1 << 14)
+#define TB_WIN (2 << 14)
+#define TB_LOSS (3 << 14)
+#define TB_RESULT(value) ((value) & (3 << 14))
+#define TB_DISTANCE(value) ((value) & 0x3fff)
+
+// A file is a header followed by the entries in the byte order of the machine,
+// then the best move of every position as a byte. The moves of a position are
+// numbered in the order jis_ask_all_moves lists them.
+#define TB_MAGIC "JITB"
+#define TB_VERSION 2
+#define TB_HEADER_SIZE 32
+#define TB_NO_MOVE 0xff
+
+typedef struct {
+  char signature[TB_SIGNATURE_SIZE];
+
+  // NULL if there is no table for the signature.
+  void *map;
+  size_t map_size;
+
+  const uint16_t *values;
+  const uint8_t *best_moves;
+  uint64_t entry_count;
+} tablebase_file;
+
+// The tables of a directory, mapped when first needed.
+typedef struct {
+  const char *directory;
+
+  tablebase_file files[TB_MAX_FILES];
+  size_t file_count;
+} tablebase;
+
+// Get the signature of a board, returns false if there are too many pieces.
+bool tb_signature(const char *board, char signature[TB_SIGNATURE_SIZE]);
+
+// Number of entries of a table.
+uint64_t tb_entry_count(const char *signature);
+
+uint64_t tb_index(const char *board, bool turn, const char *signature);
+
+// Place the pieces of an index, returns false for invalid indices.
+bool tb_board(uint64_t index, const char *signature, char *board, bool *turn);
+
+void tablebase_init(tablebase *tablebase, const char *directory);
+
+void tablebase_free(tablebase *tablebase);
+
+// Get the value of a position, or TB_INVALID if there is no table for it.
+uint16_t tablebase_probe(tablebase *tablebase, const char *board, bool turn);
+
+// Find the best move of the position in the tables, using the process to list
+// the moves. The position of the process is not changed. Returns false if the
+// position is not in the tables.
+bool tablebase_best_move(tablebase *tablebase, jis_process *process,
+                         char *board, bool turn, move *result);
+
+// Solve a table by retrograde analysis with thread_count threads, each with
+// its own engine process that is asked for the moves and successors of many
+// positions at once. The tables it depends on are generated first if they are
+// missing.
+bool tablebase_generate(const char *directory, const char *signature,
+                        const char *executable, int thread_count);
+
+#endif
@@ -0,0 +1,63 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "timing.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+uint64_t timing_now_ns() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+uint64_t timing_now_ms() { return timing_now_ns() / 1000000; }
+
+void latency_add(latency_samples *latency, uint64_t ns) {
+  latency->samples[latency->count++ % LATENCY_SAMPLES] = ns;
+}
+
+static int compare_samples(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+void timing_percentiles(uint64_t *values, size_t count,
+                        const double *fractions, uint64_t *results,
+                        int result_count) {
+  if (count == 0) {
+    memset(results, 0, result_count * sizeof(*results));
+    return;
+  }
+
+  qsort(values, count, sizeof(*values), compare_samples);
+  for (int i = 0; i < result_count; i++)
+    results[i] = values[(size_t)(fractions[i] * (count - 1) + 0.5)];
+}
+
+size_t latency_percentiles(const latency_samples *latency,
+                           const double *fractions, uint64_t *results,
+                           int count) {
+  size_t kept = latency->count < LATENCY_SAMPLES ? latency->count
+                                                 : LATENCY_SAMPLES;
+
+  uint64_t sorted[LATENCY_SAMPLES];
+  memcpy(sorted, latency->samples, kept * sizeof(*sorted));
+  timing_percentiles(sorted, kept, fractions, results, count);
+  return kept;
+}
@@ -0,0 +1,52 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LATENCY_SAMPLES 512
+
+// The most recent latencies, in nanoseconds, kept in a ring.
+typedef struct {
+  uint64_t samples[LATENCY_SAMPLES];
+  size_t count;
+} latency_samples;
+
+// Milliseconds elapsed on a monotonic clock, unaffected by changes to the wall
+// clock.
+uint64_t timing_now_ms();
+
+// Same as timing_now_ms but in nanoseconds.
+uint64_t timing_now_ns();
+
+void latency_add(latency_samples *latency, uint64_t ns);
+
+// Fill results with the given percentiles (0 to 1) of the values, sorting
+// them. The results are all zero if there are no values.
+void timing_percentiles(uint64_t *values, size_t count,
+                        const double *fractions, uint64_t *results,
+                        int result_count);
+
+// Fill results with the given percentiles (0 to 1) of the kept samples, all
+// zero if there are none. Returns the number of samples they are taken from.
+size_t latency_percentiles(const latency_samples *latency,
+                           const double *fractions, uint64_t *results,
+                           int count);
+
+#endif
@@ -0,0 +1,34 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "transcript.h"
+
+#include <stdio.h>
+
+// The engine traffic is logged by jis_process, which has no replay at hand.
+static FILE *transcript;
+
+void transcript_set_file(FILE *file) { transcript = file; }
+
+void transcript_log_command(int index, const char *command) {
+  if (transcript)
+    fprintf(transcript, "> %d %s", index, command);
+}
+
+void transcript_log_reply(int index, const char *reply) {
+  if (transcript)
+    fprintf(transcript, "< %d %s\n", index, reply);
+}
@@ -0,0 +1,36 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRANSCRIPT_H
+#define TRANSCRIPT_H
+
+#include <stdio.h>
+
+// The traffic with the engines, logged while a session is recorded as
+//
+//   > index command   sent to the engine with index
+//   < index reply     read from the engine with index
+//
+// This only needs a file, so the protocol layer does not depend on the replay
+// and through it on the window.
+
+// Start logging to the file, or stop if it is NULL. The file is not closed.
+void transcript_set_file(FILE *file);
+
+void transcript_log_command(int index, const char *command);
+void transcript_log_reply(int index, const char *reply);
+
+#endif
@@ -0,0 +1,336 @@
+/*
+This file is part of jis-gui.
+
+jis-gui is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+jis-gui is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+jis-gui. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// A stand-in for the jazzinsea engine, speaking the same protocol with much
+// simpler rules. It is used to exercise the GUI without the real engine, for
+// benchmarks and profiling runs.
+//
+// Pawns step forward and capture diagonally forward, becoming knights on the
+// last row. Knights step or capture in the four orthogonal directions. A
+// player without pieces or moves loses.
+//
+// If JIS_STANDIN_TRANSCRIPT names a session recorded by the GUI, commands
+// found in it are answered with the recorded replies of the engine with the
+// index given as "-i index", so that sessions can be replayed exactly.
+
+#include "fen.h"
+#include "position.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *START_FEN = "8/PPPPPPPP/8/N2NN2N/n2nn2n/8/pppppppp/8 w";
+
+static char board[64];
+static bool turn;
+
+typedef struct {
+  int from;
+  int to;
+  int capture;
+} standin_move;
+
+static bool is_own(char piece, bool white) {
+  return piece != ' ' && !isupper(piece) == !white;
+}
+
+static int piece_moves(int from, standin_move moves[4]) {
+  char piece = board[from];
+  bool white = isupper(piece);
+  int row = to_row(from), col = to_col(from);
+  int count = 0;
+
+  if (toupper(piece) == 'P') {
+    int forward = white ? 1 : -1;
+    if (row + forward < 0 || row + forward > 7)
+      return 0;
+
+    int to = to_position(row + forward, col);
+    if (board[to] == ' ')
+      moves[count++] = (standin_move){from, to, POSITION_INV};
+
+    for (int side = -1; side <= 1; side += 2) {
+      if (col + side < 0 || col + side > 7)
+        continue;
+      to = to_position(row + forward, col + side);
+      if (board[to] != ' ' && !is_own(board[to], white))
+        moves[count++] = (standin_move){from, to, to};
+    }
+  } else {
+    static const int steps[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    for (int i = 0; i < 4; i++) {
+      int to_r = row + steps[i][0], to_c = col + steps[i][1];
+      if (to_r < 0 || to_r > 7 || to_c < 0 || to_c > 7)
+        continue;
+      int to = to_position(to_r, to_c);
+      if (board[to] == ' ')
+        moves[count++] = (standin_move){from, to, POSITION_INV};
+      else if (!is_own(board[to], white))
+        moves[count++] = (standin_move){from, to, to};
+    }
+  }
+
+  return count;
+}
+
+static int all_moves(standin_move *moves) {
+  int count = 0;
+  for (int position = 0; position < 64; position++) {
+    if (is_own(board[position], turn))
+      count += piece_moves(position, moves + count);
+  }
+  return count;
+}
+
+static int status() {
+  bool white_pieces = false, black_pieces = false;
+  for (int position = 0; position < 64; position++) {
+    white_pieces |= is_own(board[position], true);
+    black_pieces |= is_own(board[position], false);
+  }
+
+  standin_move moves[256];
+  if (!white_pieces || (turn && !all_moves(moves)))
+    return 3 << 4;
+  if (!black_pieces || (!turn && !all_moves(moves)))
+    return 2 << 4;
+  return 0;
+}
+
+static void move_string(standin_move move, char string[5]) {
+  get_position_str(move.from, string);
+  get_position_str(move.to, string + 2);
+}
+
+static bool find_move(char *string, standin_move *result) {
+  standin_move moves[256];
+  int count = all_moves(moves);
+  for (int i = 0; i < count; i++) {
+    char candidate[5];
+    move_string(moves[i], candidate);
+    if (!strncmp(candidate, string, 4)) {
+      *result = moves[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+// The GUI describes moves after making them, so the last one is remembered.
+static standin_move last_move = {POSITION_INV, POSITION_INV, POSITION_INV};
+
+static void make_move(standin_move move) {
+  last_move = move;
+
+  char piece = board[move.from];
+  board[move.from] = ' ';
+  if (is_valid(move.capture))
+    board[move.capture] = ' ';
+
+  // Pawns become knights on the last row.
+  if (piece == 'P' && to_row(move.to) == 7)
+    piece = 'N';
+  if (piece == 'p' && to_row(move.to) == 0)
+    piece = 'n';
+  board[move.to] = piece;
+  turn = !turn;
+}
+
+// Replies must be written at once, the GUI reads them with a single read.
+static void reply(const char *format, ...) {
+  char buffer[1024];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+
+  // The GUI went away if the pipe can not be written to.
+  for (int written = 0; written < length;) {
+    ssize_t result = write(STDOUT_FILENO, buffer + written, length - written);
+    if (result < 0) {
+      if (errno == EINTR)
+        continue;
+      exit(1);
+    }
+    written += result;
+  }
+}
+
+// The recorded commands of this engine, each followed by its reply or NULL.
+static char **transcript;
+static size_t transcript_length;
+static size_t transcript_cursor;
+
+static void load_transcript(const char *path, int index) {
+  FILE *file = fopen(path, "r");
+  if (!file)
+    return;
+
+  char line[1024];
+  size_t capacity = 0;
+  while (fgets(line, sizeof(line), file)) {
+    char direction;
+    int line_index, offset;
+    if (sscanf(line, "%c %d %n", &direction, &line_index, &offset) != 2 ||
+        (direction != '>' && direction != '<') || line_index != index)
+      continue;
+    line[strcspn(line, "\n")] = '\0';
+
+    if (transcript_length + 2 > capacity) {
+      capacity = capacity ? capacity * 2 : 256;
+      transcript = realloc(transcript, capacity * sizeof(char *));
+      if (!transcript)
+        exit(1);
+    }
+
+    if (direction == '>') {
+      transcript[transcript_length++] = strdup(line + offset);
+      transcript[transcript_length++] = NULL;
+    } else if (transcript_length && !transcript[transcript_length - 1]) {
+      transcript[transcript_length - 1] = strdup(line + offset);
+    }
+  }
+  fclose(file);
+}
+
+// Return the recorded reply to the command, or NULL if it has none or was not
+// recorded. Commands are matched in order, skipping the ones not sent again.
+static const char *recorded_reply(const char *command) {
+  for (size_t i = transcript_cursor; i < transcript_length; i += 2) {
+    if (strcmp(transcript[i], command))
+      continue;
+    transcript_cursor = i + 2;
+    return transcript[i + 1];
+  }
+  return NULL;
+}
+
+int main(int argc, char *argv[]) {
+  load_fen(START_FEN, board, &turn);
+
+  // Other arguments are the ones of the real engine, and ignored.
+  int index = 0;
+  for (int i = 1; i + 1 < argc; i++) {
+    if (!strcmp(argv[i], "-i"))
+      index = strtol(argv[i + 1], NULL, 10);
+  }
+
+  const char *transcript_path = getenv("JIS_STANDIN_TRANSCRIPT");
+  if (transcript_path)
+    load_transcript(transcript_path, index);
+
+  const char *delay_string = getenv("JIS_STANDIN_DELAY");
+  long delay_ms = delay_string ? strtol(delay_string, NULL, 10) : 0;
+  srand(getpid());
+
+  char line[512];
+  while (fgets(line, sizeof(line), stdin)) {
+    line[strcspn(line, "\n")] = '\0';
+
+    const char *recorded = recorded_reply(line);
+    if (recorded) {
+      reply("%s\n", recorded);
+      continue;
+    }
+
+    char *argument = strchr(line, ' ');
+    if (argument)
+      *argument++ = '\0';
+    else
+      argument = line + strlen(line);
+
+    if (!strcmp(line, "savefen")) {
+      char fen[128];
+      get_fen_string(fen, board, turn);
+      reply("%s\n", fen);
+
+    } else if (!strcmp(line, "loadfen")) {
+      char new_board[64];
+      bool new_turn;
+      if (load_fen(argument, new_board, &new_turn)) {
+        memcpy(board, new_board, sizeof(board));
+        turn = new_turn;
+      }
+
+    } else if (!strcmp(line, "status")) {
+      reply("%d\n", status());
+
+    } else if (!strcmp(line, "makemove")) {
+      standin_move move;
+      if (find_move(argument, &move))
+        make_move(move);
+
+    } else if (!strcmp(line, "descmove")) {
+      char last_string[5] = "";
+      if (is_valid(last_move.from))
+        move_string(last_move, last_string);
+
+      standin_move move = last_move;
+      if (strncmp(argument, last_string, 4) && !find_move(argument, &move)) {
+        reply("invalid\n");
+        continue;
+      }
+
+      char from[3], to[3], capture[3] = "-";
+      get_position_str(move.from, from);
+      get_position_str(move.to, to);
+      if (is_valid(move.capture))
+        get_position_str(move.capture, capture);
+      reply("%s %s %s\n", from, to, capture);
+
+    } else if (!strcmp(line, "allmoves")) {
+      char buffer[256] = "{ ";
+      int position = str_to_position(argument);
+      if (is_valid(position) && is_own(board[position], turn)) {
+        standin_move moves[4];
+        int count = piece_moves(position, moves);
+        for (int i = 0; i < count; i++) {
+          char string[5];
+          move_string(moves[i], string);
+          strcat(buffer, string);
+          strcat(buffer, " ");
+        }
+      }
+      reply("%s}\n", buffer);
+
+    } else if (!strcmp(line, "evaluate")) {
+      if (delay_ms) {
+        struct timespec delay = {delay_ms / 1000, delay_ms % 1000 * 1000000};
+        nanosleep(&delay, NULL);
+      }
+
+      standin_move moves[256];
+      int count = all_moves(moves);
+      if (!count) {
+        reply("none\n");
+        continue;
+      }
+
+      char string[5];
+      move_string(moves[rand() % count], string);
+      reply("%s\n", string);
+    }
+  }
+
+  return 0;
+}